@@ -0,0 +1,199 @@
+#include "aabb_tree.h"
+
+#include <assert.h>
+
+namespace flux {
+
+AABBTree::AABBTree(float margin) : margin_(margin), root_(NULL_NODE), free_list_(NULL_NODE) {}
+
+int32_t AABBTree::createProxy(const aabb_t &bounds, uint32_t user_data) {
+  int32_t proxy = allocateNode();
+  nodes_[proxy].bounds = aabb::fatten(bounds, margin_);
+  nodes_[proxy].user_data = user_data;
+  nodes_[proxy].height = 0;
+  insertLeaf(proxy);
+  return proxy;
+}
+
+void AABBTree::destroyProxy(int32_t proxy) {
+  assert(isLeaf(proxy));
+  removeLeaf(proxy);
+  freeNode(proxy);
+}
+
+bool AABBTree::moveProxy(int32_t proxy, const aabb_t &bounds) {
+  assert(isLeaf(proxy));
+  if (aabb::contains(nodes_[proxy].bounds, bounds))
+    return false;
+
+  removeLeaf(proxy);
+  nodes_[proxy].bounds = aabb::fatten(bounds, margin_);
+  insertLeaf(proxy);
+  return true;
+}
+
+int32_t AABBTree::allocateNode() {
+  int32_t node;
+  if (free_list_ != NULL_NODE) {
+    node = free_list_;
+    free_list_ = nodes_[node].parent;
+  } else {
+    node = (int32_t)nodes_.size();
+    nodes_.push_back(tree_node_t());
+  }
+  nodes_[node].parent = NULL_NODE;
+  nodes_[node].child1 = NULL_NODE;
+  nodes_[node].child2 = NULL_NODE;
+  nodes_[node].height = 0;
+  nodes_[node].user_data = 0;
+  return node;
+}
+
+void AABBTree::freeNode(int32_t node) {
+  nodes_[node].parent = free_list_;
+  nodes_[node].height = -1;
+  free_list_ = node;
+}
+
+void AABBTree::insertLeaf(int32_t leaf) {
+  if (root_ == NULL_NODE) {
+    root_ = leaf;
+    nodes_[leaf].parent = NULL_NODE;
+    return;
+  }
+
+  // walk down picking whichever side grows the total perimeter the least
+  aabb_t leaf_bounds = nodes_[leaf].bounds;
+  int32_t sibling = root_;
+  while (!isLeaf(sibling)) {
+    int32_t child1 = nodes_[sibling].child1;
+    int32_t child2 = nodes_[sibling].child2;
+
+    float area = aabb::perimeter(nodes_[sibling].bounds);
+    float combined_area = aabb::perimeter(aabb::merge(nodes_[sibling].bounds, leaf_bounds));
+    // cost of making a new parent for sibling and leaf here
+    float cost = 2.0f * combined_area;
+    // minimum cost of pushing leaf further down
+    float inherit_cost = 2.0f * (combined_area - area);
+
+    float costs[2];
+    int32_t children[2] = {child1, child2};
+    for (int i = 0; i < 2; i++) {
+      const aabb_t &child_bounds = nodes_[children[i]].bounds;
+      float merged = aabb::perimeter(aabb::merge(child_bounds, leaf_bounds));
+      if (isLeaf(children[i]))
+        costs[i] = merged + inherit_cost;
+      else
+        costs[i] = merged - aabb::perimeter(child_bounds) + inherit_cost;
+    }
+
+    if (cost < costs[0] && cost < costs[1])
+      break;
+    sibling = costs[0] < costs[1] ? child1 : child2;
+  }
+
+  int32_t old_parent = nodes_[sibling].parent;
+  int32_t new_parent = allocateNode();
+  nodes_[new_parent].parent = old_parent;
+  nodes_[new_parent].bounds = aabb::merge(leaf_bounds, nodes_[sibling].bounds);
+  nodes_[new_parent].height = nodes_[sibling].height + 1;
+  nodes_[new_parent].child1 = sibling;
+  nodes_[new_parent].child2 = leaf;
+  nodes_[sibling].parent = new_parent;
+  nodes_[leaf].parent = new_parent;
+
+  if (old_parent == NULL_NODE) {
+    root_ = new_parent;
+  } else if (nodes_[old_parent].child1 == sibling) {
+    nodes_[old_parent].child1 = new_parent;
+  } else {
+    nodes_[old_parent].child2 = new_parent;
+  }
+
+  refitFrom(nodes_[leaf].parent);
+}
+
+void AABBTree::removeLeaf(int32_t leaf) {
+  if (leaf == root_) {
+    root_ = NULL_NODE;
+    return;
+  }
+
+  int32_t parent = nodes_[leaf].parent;
+  int32_t grand_parent = nodes_[parent].parent;
+  int32_t sibling = nodes_[parent].child1 == leaf ? nodes_[parent].child2 : nodes_[parent].child1;
+
+  // sibling takes the place of parent
+  freeNode(parent);
+  nodes_[sibling].parent = grand_parent;
+  if (grand_parent == NULL_NODE) {
+    root_ = sibling;
+    return;
+  }
+  if (nodes_[grand_parent].child1 == parent)
+    nodes_[grand_parent].child1 = sibling;
+  else
+    nodes_[grand_parent].child2 = sibling;
+  refitFrom(grand_parent);
+}
+
+// walks up to the root fixing heights and bounds, rebalancing on the way
+void AABBTree::refitFrom(int32_t node) {
+  while (node != NULL_NODE) {
+    node = balance(node);
+
+    int32_t child1 = nodes_[node].child1;
+    int32_t child2 = nodes_[node].child2;
+    nodes_[node].height = 1 + std::max(nodes_[child1].height, nodes_[child2].height);
+    nodes_[node].bounds = aabb::merge(nodes_[child1].bounds, nodes_[child2].bounds);
+
+    node = nodes_[node].parent;
+  }
+}
+
+// if one side of node is more than one level taller than the other, the taller
+// child is rotated up into node's place. Returns whichever node now sits there
+int32_t AABBTree::balance(int32_t a) {
+  if (isLeaf(a) || nodes_[a].height < 2)
+    return a;
+
+  int32_t b = nodes_[a].child1;
+  int32_t c = nodes_[a].child2;
+  int32_t diff = nodes_[c].height - nodes_[b].height;
+  if (diff >= -1 && diff <= 1)
+    return a;
+
+  // rotate the taller child (up) above a, and hand a its shorter grandchild
+  int32_t up = diff > 1 ? c : b;
+  int32_t other = diff > 1 ? b : c;
+  int32_t f = nodes_[up].child1;
+  int32_t g = nodes_[up].child2;
+
+  nodes_[up].child1 = a;
+  nodes_[up].parent = nodes_[a].parent;
+  nodes_[a].parent = up;
+  if (nodes_[up].parent == NULL_NODE) {
+    root_ = up;
+  } else if (nodes_[nodes_[up].parent].child1 == a) {
+    nodes_[nodes_[up].parent].child1 = up;
+  } else {
+    nodes_[nodes_[up].parent].child2 = up;
+  }
+
+  int32_t keep = nodes_[f].height > nodes_[g].height ? f : g;
+  int32_t give = keep == f ? g : f;
+  nodes_[up].child2 = keep;
+  if (diff > 1)
+    nodes_[a].child2 = give;
+  else
+    nodes_[a].child1 = give;
+  nodes_[give].parent = a;
+
+  nodes_[a].bounds = aabb::merge(nodes_[other].bounds, nodes_[give].bounds);
+  nodes_[a].height = 1 + std::max(nodes_[other].height, nodes_[give].height);
+  nodes_[up].bounds = aabb::merge(nodes_[a].bounds, nodes_[keep].bounds);
+  nodes_[up].height = 1 + std::max(nodes_[a].height, nodes_[keep].height);
+  return up;
+}
+
+} // namespace flux
@@ -0,0 +1,150 @@
+#ifndef AABB_TREE_H
+#define AABB_TREE_H
+
+#include "../data_structres/aabb.h"
+
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+namespace flux {
+
+// dynamic bounding volume tree, every proxy is stored as a leaf with its
+// bounds grown by a margin, so small movements don't touch the tree at all.
+// Internal nodes are kept balanced with AVL style rotations.
+// NOTE queries share scratch space, so only one can run at a time
+class AABBTree {
+public:
+  static constexpr int32_t NULL_NODE = -1;
+
+  AABBTree(float margin);
+
+  int32_t createProxy(const aabb_t &bounds, uint32_t user_data);
+  void destroyProxy(int32_t proxy);
+  // returns true if bounds escaped the proxy's fat bounds and it got reinserted
+  bool moveProxy(int32_t proxy, const aabb_t &bounds);
+
+  inline uint32_t getUserData(int32_t proxy) { return nodes_[proxy].user_data; }
+  inline void setUserData(int32_t proxy, uint32_t user_data) {
+    nodes_[proxy].user_data = user_data;
+  }
+  inline const aabb_t &getFatBounds(int32_t proxy) { return nodes_[proxy].bounds; }
+  inline int32_t getHeight() { return root_ == NULL_NODE ? 0 : nodes_[root_].height; }
+
+  // calls callback(user_data) for every proxy whose fat bounds overlap region,
+  // stops early if callback returns false
+  template <class F> void query(const aabb_t &region, F callback);
+  // calls callback(user_data, max_t) for every proxy whose fat bounds are hit
+  // by origin + t * dir with t in [0, max_t]. The callback returns the new
+  // max_t, so returning its exact hit distance clips the rest of the search
+  template <class F> void raycast(Vector2D origin, Vector2D dir, float max_t,
+                                  F callback);
+  // visits proxies in order of how close their fat bounds are to point, and
+  // calls callback(user_data, dist_squared) for each until it returns false.
+  // dist_squared is the squared distance to the proxy's fat bounds, so it is a
+  // lower bound on the distance to whatever the proxy stands in for
+  template <class F> void nearest(Vector2D point, F callback);
+
+private:
+  struct tree_node_t {
+    aabb_t bounds;
+    int32_t parent; // next free node when on the free list
+    int32_t child1;
+    int32_t child2;
+    int32_t height; // 0 for leaves, -1 for free nodes
+    uint32_t user_data;
+  };
+  struct nearest_entry_t {
+    float dist_squared;
+    int32_t node;
+  };
+
+  float margin_;
+  int32_t root_;
+  int32_t free_list_;
+  std::vector<tree_node_t> nodes_;
+
+  std::vector<int32_t> stack_;
+  std::vector<nearest_entry_t> heap_;
+
+  int32_t allocateNode();
+  void freeNode(int32_t node);
+  void insertLeaf(int32_t leaf);
+  void removeLeaf(int32_t leaf);
+  int32_t balance(int32_t node);
+  void refitFrom(int32_t node);
+
+  inline bool isLeaf(int32_t node) { return nodes_[node].child1 == NULL_NODE; }
+  inline static bool nearestCompare(const nearest_entry_t &e1, const nearest_entry_t &e2) {
+    return e1.dist_squared > e2.dist_squared;
+  }
+};
+
+template <class F> void AABBTree::query(const aabb_t &region, F callback) {
+  stack_.clear();
+  if (root_ != NULL_NODE)
+    stack_.push_back(root_);
+  while (!stack_.empty()) {
+    int32_t node = stack_.back();
+    stack_.pop_back();
+    if (!aabb::overlaps(nodes_[node].bounds, region))
+      continue;
+
+    if (isLeaf(node)) {
+      if (!callback(nodes_[node].user_data))
+        return;
+    } else {
+      stack_.push_back(nodes_[node].child1);
+      stack_.push_back(nodes_[node].child2);
+    }
+  }
+}
+
+template <class F>
+void AABBTree::raycast(Vector2D origin, Vector2D dir, float max_t, F callback) {
+  stack_.clear();
+  if (root_ != NULL_NODE)
+    stack_.push_back(root_);
+  while (!stack_.empty()) {
+    int32_t node = stack_.back();
+    stack_.pop_back();
+    float t;
+    if (!aabb::raycast(nodes_[node].bounds, origin, dir, max_t, t))
+      continue;
+
+    if (isLeaf(node)) {
+      max_t = callback(nodes_[node].user_data, max_t);
+    } else {
+      stack_.push_back(nodes_[node].child1);
+      stack_.push_back(nodes_[node].child2);
+    }
+  }
+}
+
+template <class F> void AABBTree::nearest(Vector2D point, F callback) {
+  // best first search, the heap is a min heap on distance to the bounds
+  heap_.clear();
+  if (root_ != NULL_NODE)
+    heap_.push_back(nearest_entry_t{aabb::distanceSquared(nodes_[root_].bounds, point), root_});
+  while (!heap_.empty()) {
+    std::pop_heap(heap_.begin(), heap_.end(), nearestCompare);
+    nearest_entry_t entry = heap_.back();
+    heap_.pop_back();
+
+    if (isLeaf(entry.node)) {
+      if (!callback(nodes_[entry.node].user_data, entry.dist_squared))
+        return;
+      continue;
+    }
+    int32_t children[2] = {nodes_[entry.node].child1, nodes_[entry.node].child2};
+    for (int32_t child : children) {
+      heap_.push_back(
+          nearest_entry_t{aabb::distanceSquared(nodes_[child].bounds, point), child});
+      std::push_heap(heap_.begin(), heap_.end(), nearestCompare);
+    }
+  }
+}
+
+} // namespace flux
+
+#endif // AABB_TREE_H
\ No newline at end of file
@@ -0,0 +1,604 @@
+#include "batch_math.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdexcept>
+
+#if FLUX_X86
+#include <immintrin.h>
+#endif
+
+// NOTE like the narrowphase, every path has to do the same multiplies, adds
+// and min/max chains in the same order to give bit identical results, so
+// a * b + c can't be contracted into an fma. AVX-512 has fma built in, so this
+// file needs the same build flags as narrowphase.cpp (see flux.vcxproj)
+
+namespace flux {
+namespace batch {
+
+// sinCos takes the angle down to r in [-pi/4, pi/4] plus a quadrant, by
+// removing the nearest multiple of pi/2 in three parts so the error from
+// rounding pi/2 doesn't grow with the angle. Adding then subtracting 1.5*2^23
+// rounds to the nearest integer, and leaves the quadrant in the low bits. The
+// polynomials are the same ones used by cephes' sinf and cosf
+static const float SINCOS_TWO_OVER_PI = 0.636619772f;
+static const float SINCOS_ROUNDER = 12582912.0f;
+static const float SINCOS_PI_2_HI = 1.5703125f;
+static const float SINCOS_PI_2_MID = 4.83751297e-4f;
+static const float SINCOS_PI_2_LO = 7.54978995e-8f;
+static const float SINCOS_SIN_1 = -1.66666546e-1f;
+static const float SINCOS_SIN_2 = 8.33216087e-3f;
+static const float SINCOS_SIN_3 = -1.95152959e-4f;
+static const float SINCOS_COS_1 = 4.16666456e-2f;
+static const float SINCOS_COS_2 = -1.38873163e-3f;
+static const float SINCOS_COS_3 = 2.44331571e-5f;
+
+// ----- Scalar Path -----
+// same semantics as minps/maxps, including which side wins on NaN
+inline static float minLane(float a, float b) { return a < b ? a : b; }
+inline static float maxLane(float a, float b) { return a > b ? a : b; }
+
+static void rotateTranslateScalar(const float *x, const float *y, const float *cos_rot,
+                                  const float *sin_rot, const float *trans_x,
+                                  const float *trans_y, size_t count, float *out_x,
+                                  float *out_y) {
+  for (size_t i = 0; i < count; i++) {
+    float rot_x = x[i] * cos_rot[i] - y[i] * sin_rot[i];
+    float rot_y = x[i] * sin_rot[i] + y[i] * cos_rot[i];
+    out_x[i] = rot_x + trans_x[i];
+    out_y[i] = rot_y + trans_y[i];
+  }
+}
+
+static void dotMinMaxScalar(const float *x, const float *y, size_t count, Vector2D axis,
+                            float *out, float &min, float &max) {
+  for (size_t i = 0; i < count; i++) {
+    float proj = x[i] * axis.x + y[i] * axis.y;
+    if (out)
+      out[i] = proj;
+    min = minLane(min, proj);
+    max = maxLane(max, proj);
+  }
+}
+
+static void normalizeScalar(const float *x, const float *y, size_t count, float *out_x,
+                            float *out_y) {
+  for (size_t i = 0; i < count; i++) {
+    float len = sqrtf(x[i] * x[i] + y[i] * y[i]);
+    out_x[i] = len != 0.0f ? x[i] / len : 0.0f;
+    out_y[i] = len != 0.0f ? y[i] / len : 0.0f;
+  }
+}
+
+static void lerpScalar(const float *a_x, const float *a_y, const float *b_x,
+                       const float *b_y, float t, size_t count, float *out_x,
+                       float *out_y) {
+  for (size_t i = 0; i < count; i++) {
+    out_x[i] = a_x[i] + (b_x[i] - a_x[i]) * t;
+    out_y[i] = a_y[i] + (b_y[i] - a_y[i]) * t;
+  }
+}
+
+inline static uint32_t floatBits(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+inline static float bitsFloat(uint32_t bits) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static void sinCosScalar(const float *angle, size_t count, float *out_sin,
+                         float *out_cos) {
+  for (size_t i = 0; i < count; i++) {
+    float shifted = angle[i] * SINCOS_TWO_OVER_PI + SINCOS_ROUNDER;
+    float k = shifted - SINCOS_ROUNDER;
+    uint32_t quadrant = floatBits(shifted);
+    float r = angle[i] - k * SINCOS_PI_2_HI - k * SINCOS_PI_2_MID - k * SINCOS_PI_2_LO;
+    float z = r * r;
+    float sin_r = ((SINCOS_SIN_3 * z + SINCOS_SIN_2) * z + SINCOS_SIN_1) * z * r + r;
+    float cos_r = ((SINCOS_COS_3 * z + SINCOS_COS_2) * z + SINCOS_COS_1) * z * z -
+                  0.5f * z + 1.0f;
+
+    // odd quadrants swap sin and cos, then the sign bits are flipped for the
+    // quadrants where each one is negative
+    float sin_val = quadrant & 1 ? cos_r : sin_r;
+    float cos_val = quadrant & 1 ? sin_r : cos_r;
+    out_sin[i] = bitsFloat(floatBits(sin_val) ^ ((quadrant & 2) << 30));
+    out_cos[i] = bitsFloat(floatBits(cos_val) ^ (((quadrant + 1) & 2) << 30));
+  }
+}
+// -----------------------
+
+#if FLUX_X86
+// ----- SSE2 Path -----
+FLUX_TARGET_SSE2
+static void rotateTranslateSSE2(const float *x, const float *y, const float *cos_rot,
+                                const float *sin_rot, const float *trans_x,
+                                const float *trans_y, size_t count, float *out_x,
+                                float *out_y) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i);
+    __m128 c = _mm_loadu_ps(cos_rot + i), s = _mm_loadu_ps(sin_rot + i);
+    __m128 rot_x = _mm_sub_ps(_mm_mul_ps(vx, c), _mm_mul_ps(vy, s));
+    __m128 rot_y = _mm_add_ps(_mm_mul_ps(vx, s), _mm_mul_ps(vy, c));
+    _mm_storeu_ps(out_x + i, _mm_add_ps(rot_x, _mm_loadu_ps(trans_x + i)));
+    _mm_storeu_ps(out_y + i, _mm_add_ps(rot_y, _mm_loadu_ps(trans_y + i)));
+  }
+  rotateTranslateScalar(x + i, y + i, cos_rot + i, sin_rot + i, trans_x + i, trans_y + i,
+                        count - i, out_x + i, out_y + i);
+}
+
+FLUX_TARGET_SSE2
+static void dotMinMaxSSE2(const float *x, const float *y, size_t count, Vector2D axis,
+                          float *out, float &min, float &max) {
+  __m128 axis_x = _mm_set1_ps(axis.x), axis_y = _mm_set1_ps(axis.y);
+  __m128 min_lanes = _mm_set1_ps(min), max_lanes = _mm_set1_ps(max);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128 proj = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x + i), axis_x),
+                             _mm_mul_ps(_mm_loadu_ps(y + i), axis_y));
+    if (out)
+      _mm_storeu_ps(out + i, proj);
+    min_lanes = _mm_min_ps(min_lanes, proj);
+    max_lanes = _mm_max_ps(max_lanes, proj);
+  }
+
+  float mins[4], maxs[4];
+  _mm_storeu_ps(mins, min_lanes);
+  _mm_storeu_ps(maxs, max_lanes);
+  for (int j = 0; j < 4; j++) {
+    min = minLane(min, mins[j]);
+    max = maxLane(max, maxs[j]);
+  }
+  dotMinMaxScalar(x + i, y + i, count - i, axis, out ? out + i : nullptr, min, max);
+}
+
+FLUX_TARGET_SSE2
+static void normalizeSSE2(const float *x, const float *y, size_t count, float *out_x,
+                          float *out_y) {
+  __m128 zero = _mm_setzero_ps();
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i);
+    __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)));
+    __m128 non_zero = _mm_cmpneq_ps(len, zero);
+    _mm_storeu_ps(out_x + i, _mm_and_ps(_mm_div_ps(vx, len), non_zero));
+    _mm_storeu_ps(out_y + i, _mm_and_ps(_mm_div_ps(vy, len), non_zero));
+  }
+  normalizeScalar(x + i, y + i, count - i, out_x + i, out_y + i);
+}
+
+FLUX_TARGET_SSE2
+static void lerpSSE2(const float *a_x, const float *a_y, const float *b_x, const float *b_y,
+                     float t, size_t count, float *out_x, float *out_y) {
+  __m128 t_lanes = _mm_set1_ps(t);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128 ax = _mm_loadu_ps(a_x + i), ay = _mm_loadu_ps(a_y + i);
+    __m128 dx = _mm_sub_ps(_mm_loadu_ps(b_x + i), ax);
+    __m128 dy = _mm_sub_ps(_mm_loadu_ps(b_y + i), ay);
+    _mm_storeu_ps(out_x + i, _mm_add_ps(ax, _mm_mul_ps(dx, t_lanes)));
+    _mm_storeu_ps(out_y + i, _mm_add_ps(ay, _mm_mul_ps(dy, t_lanes)));
+  }
+  lerpScalar(a_x + i, a_y + i, b_x + i, b_y + i, t, count - i, out_x + i, out_y + i);
+}
+
+FLUX_TARGET_SSE2
+static void sinCosSSE2(const float *angle, size_t count, float *out_sin, float *out_cos) {
+  __m128 two_over_pi = _mm_set1_ps(SINCOS_TWO_OVER_PI);
+  __m128 rounder = _mm_set1_ps(SINCOS_ROUNDER);
+  __m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128 a = _mm_loadu_ps(angle + i);
+    __m128 shifted = _mm_add_ps(_mm_mul_ps(a, two_over_pi), rounder);
+    __m128 k = _mm_sub_ps(shifted, rounder);
+    __m128i quadrant = _mm_castps_si128(shifted);
+    __m128 r = _mm_sub_ps(a, _mm_mul_ps(k, _mm_set1_ps(SINCOS_PI_2_HI)));
+    r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(SINCOS_PI_2_MID)));
+    r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(SINCOS_PI_2_LO)));
+    __m128 z = _mm_mul_ps(r, r);
+
+    __m128 sin_r = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SINCOS_SIN_3), z),
+                              _mm_set1_ps(SINCOS_SIN_2));
+    sin_r = _mm_add_ps(_mm_mul_ps(sin_r, z), _mm_set1_ps(SINCOS_SIN_1));
+    sin_r = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sin_r, z), r), r);
+    __m128 cos_r = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SINCOS_COS_3), z),
+                              _mm_set1_ps(SINCOS_COS_2));
+    cos_r = _mm_add_ps(_mm_mul_ps(cos_r, z), _mm_set1_ps(SINCOS_COS_1));
+    cos_r = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(cos_r, z), z),
+                       _mm_mul_ps(_mm_set1_ps(0.5f), z));
+    cos_r = _mm_add_ps(cos_r, _mm_set1_ps(1.0f));
+
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+    __m128 sin_val = _mm_or_ps(_mm_and_ps(swap, cos_r), _mm_andnot_ps(swap, sin_r));
+    __m128 cos_val = _mm_or_ps(_mm_and_ps(swap, sin_r), _mm_andnot_ps(swap, cos_r));
+    __m128i sin_sign = _mm_slli_epi32(_mm_and_si128(quadrant, two), 30);
+    __m128i cos_sign = _mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), two), 30);
+    _mm_storeu_ps(out_sin + i, _mm_xor_ps(sin_val, _mm_castsi128_ps(sin_sign)));
+    _mm_storeu_ps(out_cos + i, _mm_xor_ps(cos_val, _mm_castsi128_ps(cos_sign)));
+  }
+  sinCosScalar(angle + i, count - i, out_sin + i, out_cos + i);
+}
+// ---------------------
+
+// ----- AVX2 Path -----
+FLUX_TARGET_AVX2
+static void rotateTranslateAVX2(const float *x, const float *y, const float *cos_rot,
+                                const float *sin_rot, const float *trans_x,
+                                const float *trans_y, size_t count, float *out_x,
+                                float *out_y) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 vx = _mm256_loadu_ps(x + i), vy = _mm256_loadu_ps(y + i);
+    __m256 c = _mm256_loadu_ps(cos_rot + i), s = _mm256_loadu_ps(sin_rot + i);
+    __m256 rot_x = _mm256_sub_ps(_mm256_mul_ps(vx, c), _mm256_mul_ps(vy, s));
+    __m256 rot_y = _mm256_add_ps(_mm256_mul_ps(vx, s), _mm256_mul_ps(vy, c));
+    _mm256_storeu_ps(out_x + i, _mm256_add_ps(rot_x, _mm256_loadu_ps(trans_x + i)));
+    _mm256_storeu_ps(out_y + i, _mm256_add_ps(rot_y, _mm256_loadu_ps(trans_y + i)));
+  }
+  rotateTranslateSSE2(x + i, y + i, cos_rot + i, sin_rot + i, trans_x + i, trans_y + i,
+                      count - i, out_x + i, out_y + i);
+}
+
+FLUX_TARGET_AVX2
+static void dotMinMaxAVX2(const float *x, const float *y, size_t count, Vector2D axis,
+                          float *out, float &min, float &max) {
+  __m256 axis_x = _mm256_set1_ps(axis.x), axis_y = _mm256_set1_ps(axis.y);
+  __m256 min_lanes = _mm256_set1_ps(min), max_lanes = _mm256_set1_ps(max);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 proj = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(x + i), axis_x),
+                                _mm256_mul_ps(_mm256_loadu_ps(y + i), axis_y));
+    if (out)
+      _mm256_storeu_ps(out + i, proj);
+    min_lanes = _mm256_min_ps(min_lanes, proj);
+    max_lanes = _mm256_max_ps(max_lanes, proj);
+  }
+
+  float mins[8], maxs[8];
+  _mm256_storeu_ps(mins, min_lanes);
+  _mm256_storeu_ps(maxs, max_lanes);
+  for (int j = 0; j < 8; j++) {
+    min = minLane(min, mins[j]);
+    max = maxLane(max, maxs[j]);
+  }
+  dotMinMaxSSE2(x + i, y + i, count - i, axis, out ? out + i : nullptr, min, max);
+}
+
+FLUX_TARGET_AVX2
+static void normalizeAVX2(const float *x, const float *y, size_t count, float *out_x,
+                          float *out_y) {
+  __m256 zero = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 vx = _mm256_loadu_ps(x + i), vy = _mm256_loadu_ps(y + i);
+    __m256 len =
+        _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)));
+    __m256 non_zero = _mm256_cmp_ps(len, zero, _CMP_NEQ_UQ);
+    _mm256_storeu_ps(out_x + i, _mm256_and_ps(_mm256_div_ps(vx, len), non_zero));
+    _mm256_storeu_ps(out_y + i, _mm256_and_ps(_mm256_div_ps(vy, len), non_zero));
+  }
+  normalizeSSE2(x + i, y + i, count - i, out_x + i, out_y + i);
+}
+
+FLUX_TARGET_AVX2
+static void lerpAVX2(const float *a_x, const float *a_y, const float *b_x, const float *b_y,
+                     float t, size_t count, float *out_x, float *out_y) {
+  __m256 t_lanes = _mm256_set1_ps(t);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 ax = _mm256_loadu_ps(a_x + i), ay = _mm256_loadu_ps(a_y + i);
+    __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(b_x + i), ax);
+    __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(b_y + i), ay);
+    _mm256_storeu_ps(out_x + i, _mm256_add_ps(ax, _mm256_mul_ps(dx, t_lanes)));
+    _mm256_storeu_ps(out_y + i, _mm256_add_ps(ay, _mm256_mul_ps(dy, t_lanes)));
+  }
+  lerpSSE2(a_x + i, a_y + i, b_x + i, b_y + i, t, count - i, out_x + i, out_y + i);
+}
+
+FLUX_TARGET_AVX2
+static void sinCosAVX2(const float *angle, size_t count, float *out_sin, float *out_cos) {
+  __m256 two_over_pi = _mm256_set1_ps(SINCOS_TWO_OVER_PI);
+  __m256 rounder = _mm256_set1_ps(SINCOS_ROUNDER);
+  __m256i one = _mm256_set1_epi32(1), two = _mm256_set1_epi32(2);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 a = _mm256_loadu_ps(angle + i);
+    __m256 shifted = _mm256_add_ps(_mm256_mul_ps(a, two_over_pi), rounder);
+    __m256 k = _mm256_sub_ps(shifted, rounder);
+    __m256i quadrant = _mm256_castps_si256(shifted);
+    __m256 r = _mm256_sub_ps(a, _mm256_mul_ps(k, _mm256_set1_ps(SINCOS_PI_2_HI)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(k, _mm256_set1_ps(SINCOS_PI_2_MID)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(k, _mm256_set1_ps(SINCOS_PI_2_LO)));
+    __m256 z = _mm256_mul_ps(r, r);
+
+    __m256 sin_r = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(SINCOS_SIN_3), z),
+                                 _mm256_set1_ps(SINCOS_SIN_2));
+    sin_r = _mm256_add_ps(_mm256_mul_ps(sin_r, z), _mm256_set1_ps(SINCOS_SIN_1));
+    sin_r = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(sin_r, z), r), r);
+    __m256 cos_r = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(SINCOS_COS_3), z),
+                                 _mm256_set1_ps(SINCOS_COS_2));
+    cos_r = _mm256_add_ps(_mm256_mul_ps(cos_r, z), _mm256_set1_ps(SINCOS_COS_1));
+    cos_r = _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(cos_r, z), z),
+                          _mm256_mul_ps(_mm256_set1_ps(0.5f), z));
+    cos_r = _mm256_add_ps(cos_r, _mm256_set1_ps(1.0f));
+
+    __m256 swap = _mm256_castsi256_ps(
+        _mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one));
+    __m256 sin_val = _mm256_blendv_ps(sin_r, cos_r, swap);
+    __m256 cos_val = _mm256_blendv_ps(cos_r, sin_r, swap);
+    __m256i sin_sign = _mm256_slli_epi32(_mm256_and_si256(quadrant, two), 30);
+    __m256i cos_sign =
+        _mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, one), two), 30);
+    _mm256_storeu_ps(out_sin + i, _mm256_xor_ps(sin_val, _mm256_castsi256_ps(sin_sign)));
+    _mm256_storeu_ps(out_cos + i, _mm256_xor_ps(cos_val, _mm256_castsi256_ps(cos_sign)));
+  }
+  sinCosSSE2(angle + i, count - i, out_sin + i, out_cos + i);
+}
+// ---------------------
+
+// ----- AVX-512 Path -----
+FLUX_TARGET_AVX512
+static void rotateTranslateAVX512(const float *x, const float *y, const float *cos_rot,
+                                  const float *sin_rot, const float *trans_x,
+                                  const float *trans_y, size_t count, float *out_x,
+                                  float *out_y) {
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m512 vx = _mm512_loadu_ps(x + i), vy = _mm512_loadu_ps(y + i);
+    __m512 c = _mm512_loadu_ps(cos_rot + i), s = _mm512_loadu_ps(sin_rot + i);
+    __m512 rot_x = _mm512_sub_ps(_mm512_mul_ps(vx, c), _mm512_mul_ps(vy, s));
+    __m512 rot_y = _mm512_add_ps(_mm512_mul_ps(vx, s), _mm512_mul_ps(vy, c));
+    _mm512_storeu_ps(out_x + i, _mm512_add_ps(rot_x, _mm512_loadu_ps(trans_x + i)));
+    _mm512_storeu_ps(out_y + i, _mm512_add_ps(rot_y, _mm512_loadu_ps(trans_y + i)));
+  }
+  rotateTranslateAVX2(x + i, y + i, cos_rot + i, sin_rot + i, trans_x + i, trans_y + i,
+                      count - i, out_x + i, out_y + i);
+}
+
+FLUX_TARGET_AVX512
+static void dotMinMaxAVX512(const float *x, const float *y, size_t count, Vector2D axis,
+                            float *out, float &min, float &max) {
+  __m512 axis_x = _mm512_set1_ps(axis.x), axis_y = _mm512_set1_ps(axis.y);
+  __m512 min_lanes = _mm512_set1_ps(min), max_lanes = _mm512_set1_ps(max);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m512 proj = _mm512_add_ps(_mm512_mul_ps(_mm512_loadu_ps(x + i), axis_x),
+                                _mm512_mul_ps(_mm512_loadu_ps(y + i), axis_y));
+    if (out)
+      _mm512_storeu_ps(out + i, proj);
+    min_lanes = _mm512_min_ps(min_lanes, proj);
+    max_lanes = _mm512_max_ps(max_lanes, proj);
+  }
+
+  float mins[16], maxs[16];
+  _mm512_storeu_ps(mins, min_lanes);
+  _mm512_storeu_ps(maxs, max_lanes);
+  for (int j = 0; j < 16; j++) {
+    min = minLane(min, mins[j]);
+    max = maxLane(max, maxs[j]);
+  }
+  dotMinMaxAVX2(x + i, y + i, count - i, axis, out ? out + i : nullptr, min, max);
+}
+
+FLUX_TARGET_AVX512
+static void normalizeAVX512(const float *x, const float *y, size_t count, float *out_x,
+                            float *out_y) {
+  __m512 zero = _mm512_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m512 vx = _mm512_loadu_ps(x + i), vy = _mm512_loadu_ps(y + i);
+    __m512 len =
+        _mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(vx, vx), _mm512_mul_ps(vy, vy)));
+    // lanes with a zero length are zeroed by the mask instead of divided
+    __mmask16 non_zero = _mm512_cmp_ps_mask(len, zero, _CMP_NEQ_UQ);
+    _mm512_storeu_ps(out_x + i, _mm512_maskz_div_ps(non_zero, vx, len));
+    _mm512_storeu_ps(out_y + i, _mm512_maskz_div_ps(non_zero, vy, len));
+  }
+  normalizeAVX2(x + i, y + i, count - i, out_x + i, out_y + i);
+}
+
+FLUX_TARGET_AVX512
+static void lerpAVX512(const float *a_x, const float *a_y, const float *b_x,
+                       const float *b_y, float t, size_t count, float *out_x,
+                       float *out_y) {
+  __m512 t_lanes = _mm512_set1_ps(t);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m512 ax = _mm512_loadu_ps(a_x + i), ay = _mm512_loadu_ps(a_y + i);
+    __m512 dx = _mm512_sub_ps(_mm512_loadu_ps(b_x + i), ax);
+    __m512 dy = _mm512_sub_ps(_mm512_loadu_ps(b_y + i), ay);
+    _mm512_storeu_ps(out_x + i, _mm512_add_ps(ax, _mm512_mul_ps(dx, t_lanes)));
+    _mm512_storeu_ps(out_y + i, _mm512_add_ps(ay, _mm512_mul_ps(dy, t_lanes)));
+  }
+  lerpAVX2(a_x + i, a_y + i, b_x + i, b_y + i, t, count - i, out_x + i, out_y + i);
+}
+
+FLUX_TARGET_AVX512
+static void sinCosAVX512(const float *angle, size_t count, float *out_sin,
+                         float *out_cos) {
+  __m512 two_over_pi = _mm512_set1_ps(SINCOS_TWO_OVER_PI);
+  __m512 rounder = _mm512_set1_ps(SINCOS_ROUNDER);
+  __m512i one = _mm512_set1_epi32(1), two = _mm512_set1_epi32(2);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m512 a = _mm512_loadu_ps(angle + i);
+    __m512 shifted = _mm512_add_ps(_mm512_mul_ps(a, two_over_pi), rounder);
+    __m512 k = _mm512_sub_ps(shifted, rounder);
+    __m512i quadrant = _mm512_castps_si512(shifted);
+    __m512 r = _mm512_sub_ps(a, _mm512_mul_ps(k, _mm512_set1_ps(SINCOS_PI_2_HI)));
+    r = _mm512_sub_ps(r, _mm512_mul_ps(k, _mm512_set1_ps(SINCOS_PI_2_MID)));
+    r = _mm512_sub_ps(r, _mm512_mul_ps(k, _mm512_set1_ps(SINCOS_PI_2_LO)));
+    __m512 z = _mm512_mul_ps(r, r);
+
+    __m512 sin_r = _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(SINCOS_SIN_3), z),
+                                 _mm512_set1_ps(SINCOS_SIN_2));
+    sin_r = _mm512_add_ps(_mm512_mul_ps(sin_r, z), _mm512_set1_ps(SINCOS_SIN_1));
+    sin_r = _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(sin_r, z), r), r);
+    __m512 cos_r = _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(SINCOS_COS_3), z),
+                                 _mm512_set1_ps(SINCOS_COS_2));
+    cos_r = _mm512_add_ps(_mm512_mul_ps(cos_r, z), _mm512_set1_ps(SINCOS_COS_1));
+    cos_r = _mm512_sub_ps(_mm512_mul_ps(_mm512_mul_ps(cos_r, z), z),
+                          _mm512_mul_ps(_mm512_set1_ps(0.5f), z));
+    cos_r = _mm512_add_ps(cos_r, _mm512_set1_ps(1.0f));
+
+    __mmask16 swap = _mm512_test_epi32_mask(quadrant, one);
+    __m512i sin_val = _mm512_castps_si512(_mm512_mask_blend_ps(swap, sin_r, cos_r));
+    __m512i cos_val = _mm512_castps_si512(_mm512_mask_blend_ps(swap, cos_r, sin_r));
+    __m512i sin_sign = _mm512_slli_epi32(_mm512_and_si512(quadrant, two), 30);
+    __m512i cos_sign =
+        _mm512_slli_epi32(_mm512_and_si512(_mm512_add_epi32(quadrant, one), two), 30);
+    _mm512_storeu_ps(out_sin + i, _mm512_castsi512_ps(_mm512_xor_si512(sin_val, sin_sign)));
+    _mm512_storeu_ps(out_cos + i, _mm512_castsi512_ps(_mm512_xor_si512(cos_val, cos_sign)));
+  }
+  sinCosAVX2(angle + i, count - i, out_sin + i, out_cos + i);
+}
+// ------------------------
+#endif
+
+static void checkLevel(simd_level_t level) {
+  if (level > cpu::getSimdLevel())
+    throw std::invalid_argument("batch math called with an unsupported SIMD level");
+}
+
+void rotateTranslate(const float *x, const float *y, const float *cos_rot,
+                     const float *sin_rot, const float *trans_x, const float *trans_y,
+                     size_t count, float *out_x, float *out_y) {
+  rotateTranslate(cpu::getSimdLevel(), x, y, cos_rot, sin_rot, trans_x, trans_y, count,
+                  out_x, out_y);
+}
+
+void rotateTranslate(simd_level_t level, const float *x, const float *y,
+                     const float *cos_rot, const float *sin_rot, const float *trans_x,
+                     const float *trans_y, size_t count, float *out_x, float *out_y) {
+  checkLevel(level);
+  switch (level) {
+#if FLUX_X86
+  case SIMD_AVX512:
+    rotateTranslateAVX512(x, y, cos_rot, sin_rot, trans_x, trans_y, count, out_x, out_y);
+    break;
+  case SIMD_AVX2:
+    rotateTranslateAVX2(x, y, cos_rot, sin_rot, trans_x, trans_y, count, out_x, out_y);
+    break;
+  case SIMD_SSE2:
+    rotateTranslateSSE2(x, y, cos_rot, sin_rot, trans_x, trans_y, count, out_x, out_y);
+    break;
+#endif
+  default:
+    rotateTranslateScalar(x, y, cos_rot, sin_rot, trans_x, trans_y, count, out_x, out_y);
+    break;
+  }
+}
+
+void dotMinMax(const float *x, const float *y, size_t count, Vector2D axis, float *out,
+               float &min, float &max) {
+  dotMinMax(cpu::getSimdLevel(), x, y, count, axis, out, min, max);
+}
+
+void dotMinMax(simd_level_t level, const float *x, const float *y, size_t count,
+               Vector2D axis, float *out, float &min, float &max) {
+  checkLevel(level);
+  min = INFINITY;
+  max = -INFINITY;
+  switch (level) {
+#if FLUX_X86
+  case SIMD_AVX512:
+    dotMinMaxAVX512(x, y, count, axis, out, min, max);
+    break;
+  case SIMD_AVX2:
+    dotMinMaxAVX2(x, y, count, axis, out, min, max);
+    break;
+  case SIMD_SSE2:
+    dotMinMaxSSE2(x, y, count, axis, out, min, max);
+    break;
+#endif
+  default:
+    dotMinMaxScalar(x, y, count, axis, out, min, max);
+    break;
+  }
+}
+
+void normalize(const float *x, const float *y, size_t count, float *out_x, float *out_y) {
+  normalize(cpu::getSimdLevel(), x, y, count, out_x, out_y);
+}
+
+void normalize(simd_level_t level, const float *x, const float *y, size_t count,
+               float *out_x, float *out_y) {
+  checkLevel(level);
+  switch (level) {
+#if FLUX_X86
+  case SIMD_AVX512:
+    normalizeAVX512(x, y, count, out_x, out_y);
+    break;
+  case SIMD_AVX2:
+    normalizeAVX2(x, y, count, out_x, out_y);
+    break;
+  case SIMD_SSE2:
+    normalizeSSE2(x, y, count, out_x, out_y);
+    break;
+#endif
+  default:
+    normalizeScalar(x, y, count, out_x, out_y);
+    break;
+  }
+}
+
+void lerp(const float *a_x, const float *a_y, const float *b_x, const float *b_y, float t,
+          size_t count, float *out_x, float *out_y) {
+  lerp(cpu::getSimdLevel(), a_x, a_y, b_x, b_y, t, count, out_x, out_y);
+}
+
+void lerp(simd_level_t level, const float *a_x, const float *a_y, const float *b_x,
+          const float *b_y, float t, size_t count, float *out_x, float *out_y) {
+  checkLevel(level);
+  switch (level) {
+#if FLUX_X86
+  case SIMD_AVX512:
+    lerpAVX512(a_x, a_y, b_x, b_y, t, count, out_x, out_y);
+    break;
+  case SIMD_AVX2:
+    lerpAVX2(a_x, a_y, b_x, b_y, t, count, out_x, out_y);
+    break;
+  case SIMD_SSE2:
+    lerpSSE2(a_x, a_y, b_x, b_y, t, count, out_x, out_y);
+    break;
+#endif
+  default:
+    lerpScalar(a_x, a_y, b_x, b_y, t, count, out_x, out_y);
+    break;
+  }
+}
+
+void sinCos(const float *angle, size_t count, float *out_sin, float *out_cos) {
+  sinCos(cpu::getSimdLevel(), angle, count, out_sin, out_cos);
+}
+
+void sinCos(simd_level_t level, const float *angle, size_t count, float *out_sin,
+            float *out_cos) {
+  checkLevel(level);
+  switch (level) {
+#if FLUX_X86
+  case SIMD_AVX512:
+    sinCosAVX512(angle, count, out_sin, out_cos);
+    break;
+  case SIMD_AVX2:
+    sinCosAVX2(angle, count, out_sin, out_cos);
+    break;
+  case SIMD_SSE2:
+    sinCosSSE2(angle, count, out_sin, out_cos);
+    break;
+#endif
+  default:
+    sinCosScalar(angle, count, out_sin, out_cos);
+    break;
+  }
+}
+
+}
+} // namespace flux
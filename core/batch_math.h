@@ -0,0 +1,59 @@
+#ifndef BATCH_MATH_H
+#define BATCH_MATH_H
+
+#include "cpu_features.h"
+#include "../data_structres/vectors.h"
+
+#include <stddef.h>
+
+namespace flux {
+namespace batch {
+
+// math over arrays of 2D vectors that are split into x and y streams, the same
+// layout as the SAT streams, so they load straight into SIMD lanes. Each
+// function runs 16 (AVX-512), 8 (AVX2) or 4 (SSE2) vectors at a time depending
+// on the cpu, and every path does the exact same float operations as the
+// scalar one so results never depend on the machine. Outputs can be the same
+// arrays as the inputs, but shouldn't partially overlap them. The versions
+// taking a level are forced down that path, which must be supported
+
+// out = v.rotate(cos_rot, sin_rot) + trans, with every vector getting its own
+// rotation and translation
+void rotateTranslate(const float *x, const float *y, const float *cos_rot,
+                     const float *sin_rot, const float *trans_x, const float *trans_y,
+                     size_t count, float *out_x, float *out_y);
+void rotateTranslate(simd_level_t level, const float *x, const float *y,
+                     const float *cos_rot, const float *sin_rot, const float *trans_x,
+                     const float *trans_y, size_t count, float *out_x, float *out_y);
+
+// projects every vector onto axis, min and max are the smallest and largest
+// projection (+/- infinity when count is 0). out gets every projection if it
+// isn't nullptr
+void dotMinMax(const float *x, const float *y, size_t count, Vector2D axis, float *out,
+               float &min, float &max);
+void dotMinMax(simd_level_t level, const float *x, const float *y, size_t count,
+               Vector2D axis, float *out, float &min, float &max);
+
+// out = v / v.magnitude(), zero vectors stay zero
+void normalize(const float *x, const float *y, size_t count, float *out_x, float *out_y);
+void normalize(simd_level_t level, const float *x, const float *y, size_t count,
+               float *out_x, float *out_y);
+
+// out = a + (b - a) * t
+void lerp(const float *a_x, const float *a_y, const float *b_x, const float *b_y, float t,
+          size_t count, float *out_x, float *out_y);
+void lerp(simd_level_t level, const float *a_x, const float *a_y, const float *b_x,
+          const float *b_y, float t, size_t count, float *out_x, float *out_y);
+
+// out_sin/out_cos = sinf/cosf(angle), from a polynomial instead of the C
+// library. Within 1e-7 of the true values for |angle| <= 8192, with the
+// error growing past that, so angles should be kept wrapped. Infinite and NaN
+// angles give NaN
+void sinCos(const float *angle, size_t count, float *out_sin, float *out_cos);
+void sinCos(simd_level_t level, const float *angle, size_t count, float *out_sin,
+            float *out_cos);
+
+}
+} // namespace flux
+
+#endif // BATCH_MATH_H
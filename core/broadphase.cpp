@@ -0,0 +1,280 @@
+#include "broadphase.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace flux {
+
+constexpr uint32_t MIN_BUCKETS = 64;
+
+void findAllPairs(const aabb_t *bounds, size_t num_bounds,
+                  std::vector<collision_pair_t> &pairs) {
+  for (uint32_t outer = 0; outer + 1 < num_bounds; outer++) {
+    for (uint32_t inner = outer + 1; inner < num_bounds; inner++) {
+      if (aabb::overlaps(bounds[outer], bounds[inner]))
+        pairs.push_back(collision_pair_t{outer, inner});
+    }
+  }
+}
+
+// ----- SpatialHash Implementation -----
+SpatialHash::SpatialHash(float cell_size) {
+  setCellSize(cell_size);
+  bounds_ = nullptr;
+  num_bounds_ = 0;
+}
+
+void SpatialHash::setCellSize(float cell_size) {
+  if (!(cell_size > 0.0f))
+    throw std::invalid_argument("SpatialHash cell size must be positive");
+  cell_size_ = cell_size;
+  inv_cell_size_ = 1.0f / cell_size;
+}
+
+void SpatialHash::rebuild(const aabb_t *bounds, size_t num_bounds) {
+  bounds_ = bounds;
+  num_bounds_ = num_bounds;
+
+  // find every cell each bounding box touches
+  unsorted_entries_.clear();
+  for (size_t i = 0; i < num_bounds; i++) {
+    int32_t min_x = toCell(bounds[i].min.x);
+    int32_t min_y = toCell(bounds[i].min.y);
+    int32_t max_x = toCell(bounds[i].max.x);
+    int32_t max_y = toCell(bounds[i].max.y);
+    for (int32_t y = min_y; y <= max_y; y++) {
+      for (int32_t x = min_x; x <= max_x; x++) {
+        unsorted_entries_.push_back(cell_entry_t{x, y, (uint32_t)i});
+      }
+    }
+  }
+
+  // keep roughly one entry per bucket so chains stay short
+  uint32_t num_buckets = MIN_BUCKETS;
+  while (num_buckets < unsorted_entries_.size())
+    num_buckets <<= 1;
+  uint32_t mask = num_buckets - 1;
+
+  // counting sort the entries into their buckets
+  bucket_starts_.assign(num_buckets + 1, 0);
+  for (auto &entry : unsorted_entries_)
+    bucket_starts_[hashCell(entry.x, entry.y, mask) + 1]++;
+  for (uint32_t i = 1; i <= num_buckets; i++)
+    bucket_starts_[i] += bucket_starts_[i - 1];
+
+  entries_.resize(unsorted_entries_.size());
+  for (auto &entry : unsorted_entries_) {
+    // bucket_starts_[hash] is used as the insert cursor, and is shifted back
+    // into place once every entry is in
+    entries_[bucket_starts_[hashCell(entry.x, entry.y, mask)]++] = entry;
+  }
+  for (uint32_t i = num_buckets; i > 0; i--)
+    bucket_starts_[i] = bucket_starts_[i - 1];
+  bucket_starts_[0] = 0;
+}
+
+void SpatialHash::findPairs(std::vector<collision_pair_t> &pairs) {
+  size_t num_buckets = bucket_starts_.size() ? bucket_starts_.size() - 1 : 0;
+  for (size_t bucket = 0; bucket < num_buckets; bucket++) {
+    uint32_t end = bucket_starts_[bucket + 1];
+    for (uint32_t outer = bucket_starts_[bucket]; outer < end; outer++) {
+      cell_entry_t &outer_entry = entries_[outer];
+      const aabb_t &outer_bounds = bounds_[outer_entry.idx];
+
+      for (uint32_t inner = outer + 1; inner < end; inner++) {
+        // different cells can hash into the same bucket
+        cell_entry_t &inner_entry = entries_[inner];
+        if (inner_entry.x != outer_entry.x || inner_entry.y != outer_entry.y)
+          continue;
+
+        const aabb_t &inner_bounds = bounds_[inner_entry.idx];
+        if (!aabb::overlaps(outer_bounds, inner_bounds))
+          continue;
+
+        // boxes spanning multiple cells will meet more than once, so only
+        // report the pair from the cell holding the min corner of the overlap
+        float overlap_x = fmaxf(outer_bounds.min.x, inner_bounds.min.x);
+        float overlap_y = fmaxf(outer_bounds.min.y, inner_bounds.min.y);
+        if (toCell(overlap_x) != outer_entry.x || toCell(overlap_y) != outer_entry.y)
+          continue;
+
+        if (outer_entry.idx < inner_entry.idx)
+          pairs.push_back(collision_pair_t{outer_entry.idx, inner_entry.idx});
+        else
+          pairs.push_back(collision_pair_t{inner_entry.idx, outer_entry.idx});
+      }
+    }
+  }
+}
+
+void SpatialHash::query(const aabb_t &region, std::vector<uint32_t> &hits) {
+  if (bucket_starts_.size() < 2)
+    return;
+  uint32_t mask = (uint32_t)bucket_starts_.size() - 2;
+
+  int32_t min_x = toCell(region.min.x);
+  int32_t min_y = toCell(region.min.y);
+  int32_t max_x = toCell(region.max.x);
+  int32_t max_y = toCell(region.max.y);
+  for (int32_t y = min_y; y <= max_y; y++) {
+    for (int32_t x = min_x; x <= max_x; x++) {
+      uint32_t bucket = hashCell(x, y, mask);
+      uint32_t end = bucket_starts_[bucket + 1];
+      for (uint32_t i = bucket_starts_[bucket]; i < end; i++) {
+        cell_entry_t &entry = entries_[i];
+        if (entry.x != x || entry.y != y)
+          continue;
+
+        const aabb_t &bounds = bounds_[entry.idx];
+        if (!aabb::overlaps(bounds, region))
+          continue;
+
+        // same trick as findPairs, only the cell holding the min corner of
+        // the overlap reports it
+        if (toCell(fmaxf(bounds.min.x, region.min.x)) != x ||
+            toCell(fmaxf(bounds.min.y, region.min.y)) != y)
+          continue;
+        hits.push_back(entry.idx);
+      }
+    }
+  }
+}
+// --------------------------------------
+
+// ---- SweepAndPrune Implementation ----
+void SweepAndPrune::update(const aabb_t *bounds, size_t num_bounds) {
+  // drop the endpoints and pairs of any bounds that were removed
+  if (num_bounds < num_bounds_) {
+    for (auto &endpoints : endpoints_) {
+      size_t kept = 0;
+      for (size_t i = 0; i < endpoints.size(); i++) {
+        if (getIdx(endpoints[i]) < num_bounds)
+          endpoints[kept++] = endpoints[i];
+      }
+      endpoints.resize(kept);
+    }
+    // b is the higher index, so it's the only one that can be gone
+    pairs_.erase(std::remove_if(pairs_.begin(), pairs_.end(),
+                                [&](uint64_t pair) {
+                                  return (pair & 0xFFFFFFFF) >= num_bounds;
+                                }),
+                 pairs_.end());
+  }
+
+  // refresh the endpoints we are already tracking, then tack on the new ones
+  tracked_.resize(num_bounds, 0);
+  for (size_t axis = 0; axis < 2; axis++) {
+    for (auto &endpoint : endpoints_[axis]) {
+      const aabb_t &bound = bounds[getIdx(endpoint)];
+      const Vector2D &corner = isMax(endpoint) ? bound.max : bound.min;
+      endpoint.value = axis == 0 ? corner.x : corner.y;
+    }
+    for (size_t idx = 0; idx < num_bounds; idx++) {
+      if (tracked_[idx])
+        continue;
+      const aabb_t &bound = bounds[idx];
+      uint32_t idx_flag = (uint32_t)idx << 1;
+      endpoints_[axis].push_back(
+          endpoint_t{axis == 0 ? bound.min.x : bound.min.y, idx_flag});
+      endpoints_[axis].push_back(
+          endpoint_t{axis == 0 ? bound.max.x : bound.max.y, idx_flag | 1});
+    }
+  }
+  std::fill(tracked_.begin(), tracked_.end(), 1);
+  num_bounds_ = num_bounds;
+
+  changed_.clear();
+  sortAxis(endpoints_[0]);
+  sortAxis(endpoints_[1]);
+  mergeChanged(bounds);
+}
+
+void SweepAndPrune::sortAxis(std::vector<endpoint_t> &endpoints) {
+  // insertion sort, each time a min passes a max (or the other way around)
+  // the two boxes may have started or stopped overlapping
+  for (size_t i = 1; i < endpoints.size(); i++) {
+    endpoint_t key = endpoints[i];
+    size_t j = i;
+    while (j > 0 && isBefore(key, endpoints[j - 1])) {
+      endpoint_t &passed = endpoints[j - 1];
+      if (isMax(key) != isMax(passed))
+        changed_.push_back(packPair(getIdx(key), getIdx(passed)));
+      endpoints[j] = passed;
+      j--;
+    }
+    endpoints[j] = key;
+  }
+}
+
+void SweepAndPrune::mergeChanged(const aabb_t *bounds) {
+  if (changed_.empty())
+    return;
+  std::sort(changed_.begin(), changed_.end());
+  changed_.erase(std::unique(changed_.begin(), changed_.end()), changed_.end());
+
+  // a changed pair can swap several times in one update, but once both axes
+  // are sorted it's in the list exactly when the boxes overlap
+  merged_.clear();
+  size_t pair_idx = 0;
+  for (uint64_t changed : changed_) {
+    while (pair_idx < pairs_.size() && pairs_[pair_idx] < changed)
+      merged_.push_back(pairs_[pair_idx++]);
+    if (pair_idx < pairs_.size() && pairs_[pair_idx] == changed)
+      pair_idx++;
+    if (aabb::overlaps(bounds[changed >> 32], bounds[changed & 0xFFFFFFFF]))
+      merged_.push_back(changed);
+  }
+  merged_.insert(merged_.end(), pairs_.begin() + pair_idx, pairs_.end());
+  pairs_.swap(merged_);
+}
+
+void SweepAndPrune::remap(const uint32_t *new_idxs) {
+  // relabelling keeps the endpoints sorted since their values don't change,
+  // only the removed ones have to be squeezed out
+  size_t num_bounds = 0;
+  for (auto &endpoints : endpoints_) {
+    size_t kept = 0;
+    for (size_t i = 0; i < endpoints.size(); i++) {
+      uint32_t new_idx = new_idxs[getIdx(endpoints[i])];
+      if (new_idx == REMOVED_IDX)
+        continue;
+      uint32_t idx_flag = new_idx << 1 | (endpoints[i].idx_flag & 1);
+      endpoints[kept++] = endpoint_t{endpoints[i].value, idx_flag};
+      num_bounds = std::max(num_bounds, (size_t)new_idx + 1);
+    }
+    endpoints.resize(kept);
+  }
+
+  size_t kept = 0;
+  for (size_t i = 0; i < pairs_.size(); i++) {
+    uint32_t a = new_idxs[pairs_[i] >> 32];
+    uint32_t b = new_idxs[pairs_[i] & 0xFFFFFFFF];
+    if (a != REMOVED_IDX && b != REMOVED_IDX)
+      pairs_[kept++] = packPair(a, b);
+  }
+  pairs_.resize(kept);
+  std::sort(pairs_.begin(), pairs_.end());
+
+  // bounds that moved into the gaps left by removed ones show up as untracked
+  // on the next update
+  tracked_.assign(num_bounds, 0);
+  for (const auto &endpoint : endpoints_[0])
+    tracked_[getIdx(endpoint)] = 1;
+  num_bounds_ = num_bounds;
+}
+
+void SweepAndPrune::findPairs(std::vector<collision_pair_t> &pairs) {
+  for (uint64_t pair : pairs_)
+    pairs.push_back(collision_pair_t{(uint32_t)(pair >> 32), (uint32_t)pair});
+}
+
+void SweepAndPrune::clear() {
+  endpoints_[0].clear();
+  endpoints_[1].clear();
+  pairs_.clear();
+  tracked_.clear();
+  num_bounds_ = 0;
+}
+// --------------------------------------
+
+} // namespace flux
\ No newline at end of file
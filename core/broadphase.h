@@ -0,0 +1,144 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include "../data_structres/aabb.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace flux {
+
+// indices of two colliders whose bounds overlap, a is always the lower index
+struct collision_pair_t {
+  uint32_t a;
+  uint32_t b;
+};
+
+enum broadphase_t {
+  BROADPHASE_ALL_PAIRS,
+  BROADPHASE_SPATIAL_HASH,
+  BROADPHASE_SWEEP_AND_PRUNE
+};
+
+// appends every overlapping pair of bounds by testing all of them against
+// each other, mostly useful as a baseline for the other broadphases
+void findAllPairs(const aabb_t *bounds, size_t num_bounds,
+                  std::vector<collision_pair_t> &pairs);
+
+// uniform grid broadphase, each bounding box is bucketed into every cell it
+// touches and only boxes sharing a cell are paired up
+class SpatialHash {
+public:
+  SpatialHash(float cell_size);
+
+  void setCellSize(float cell_size);
+  inline float getCellSize() { return cell_size_; }
+
+  // throws away the old grid and buckets the given bounds from scratch
+  void rebuild(const aabb_t *bounds, size_t num_bounds);
+  // appends every overlapping pair of bounds from the last rebuild, each pair
+  // is only reported once even if the boxes share multiple cells
+  void findPairs(std::vector<collision_pair_t> &pairs);
+  // appends the index of every bounds from the last rebuild that overlaps
+  // region, each one only once
+  void query(const aabb_t &region, std::vector<uint32_t> &hits);
+
+private:
+  struct cell_entry_t {
+    int32_t x;
+    int32_t y;
+    uint32_t idx;
+  };
+
+  float cell_size_;
+  float inv_cell_size_;
+
+  const aabb_t *bounds_;
+  size_t num_bounds_;
+
+  // entries_ is sorted by bucket, bucket i lives in
+  // [bucket_starts_[i], bucket_starts_[i + 1])
+  std::vector<cell_entry_t> entries_;
+  std::vector<cell_entry_t> unsorted_entries_;
+  std::vector<uint32_t> bucket_starts_;
+
+  inline int32_t toCell(float pos) {
+    return (int32_t)floorf(pos * inv_cell_size_);
+  }
+  inline static uint32_t hashCell(int32_t x, int32_t y, uint32_t mask) {
+    return (((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u)) & mask;
+  }
+};
+
+// sweep and prune broadphase that takes advantage of colliders barely moving
+// between frames. The min/max endpoints of every box are kept sorted along
+// both axes across updates, so re-sorting is close to linear with insertion
+// sort, and every swap of two endpoints flags that pair as changed. Changed
+// pairs are merged into the sorted pair list once both axes are sorted, so
+// keeping the pairs up to date doesn't allocate once the lists have grown
+class SweepAndPrune {
+public:
+  // marks bounds that are gone in the table passed to remap
+  static constexpr uint32_t REMOVED_IDX = 0xFFFFFFFF;
+
+  SweepAndPrune() : num_bounds_(0) {}
+
+  // refreshes the endpoints from bounds and re-sorts them, bounds that
+  // weren't tracked by the last update or remap are treated as newly added,
+  // and any that fall off the end are removed
+  void update(const aabb_t *bounds, size_t num_bounds);
+  // moves every tracked bounds index i to new_idxs[i] without touching the
+  // sorted endpoints, bounds mapped to REMOVED_IDX are dropped along with
+  // their pairs. new_idxs needs an entry for each bounds of the last update
+  void remap(const uint32_t *new_idxs);
+  // appends every pair of bounds that overlapped as of the last update,
+  // sorted by a then b
+  void findPairs(std::vector<collision_pair_t> &pairs);
+  // forgets every tracked bounds and pair
+  void clear();
+
+  inline size_t getNumPairs() { return pairs_.size(); }
+
+private:
+  // idx_flag holds the bounds index shifted up by one, and the low bit is set
+  // for max endpoints
+  struct endpoint_t {
+    float value;
+    uint32_t idx_flag;
+  };
+
+  size_t num_bounds_;
+  // non zero for every bounds index that already has endpoints
+  std::vector<uint8_t> tracked_;
+  std::vector<endpoint_t> endpoints_[2];
+  // overlapping pairs packed as (a << 32 | b), kept sorted
+  std::vector<uint64_t> pairs_;
+  // pairs whose endpoints swapped during this update, and scratch for merging
+  // them into pairs_
+  std::vector<uint64_t> changed_;
+  std::vector<uint64_t> merged_;
+
+  void sortAxis(std::vector<endpoint_t> &endpoints);
+  void mergeChanged(const aabb_t *bounds);
+
+  inline static uint32_t getIdx(const endpoint_t &endpoint) {
+    return endpoint.idx_flag >> 1;
+  }
+  inline static bool isMax(const endpoint_t &endpoint) {
+    return endpoint.idx_flag & 1;
+  }
+  // min endpoints go first on ties, so touching boxes count as overlapping
+  inline static bool isBefore(const endpoint_t &e1, const endpoint_t &e2) {
+    return e1.value < e2.value ||
+           (e1.value == e2.value && !isMax(e1) && isMax(e2));
+  }
+  inline static uint64_t packPair(uint32_t idx1, uint32_t idx2) {
+    if (idx1 > idx2)
+      return ((uint64_t)idx2 << 32) | idx1;
+    return ((uint64_t)idx1 << 32) | idx2;
+  }
+};
+
+} // namespace flux
+
+#endif // BROADPHASE_H
\ No newline at end of file
@@ -1,9 +1,26 @@
 #include "collision_manager.h"
+#include "batch_math.h"
 
+#include <algorithm>
 #include <stdexcept>
 
 namespace flux {
 
+// work is split into fixed size chunks rather than one per thread, so the
+// order results are merged in never depends on the thread count
+constexpr size_t CACHE_CHUNK_SIZE = 1024;
+constexpr size_t NARROWPHASE_CHUNK_SIZE = 256;
+constexpr size_t TILEMAP_CHUNK_SIZE = 256;
+// dirty rectangles are transformed this many at a time, small enough for the
+// corner scratch to live on the stack
+constexpr size_t CACHE_BATCH_SIZE = 64;
+// how far the query tree's bounds reach past each rectangle, anything that
+// moves less than this between frames doesn't have to be reinserted
+constexpr float QUERY_TREE_MARGIN = 0.05f;
+// address space is reserved for this many rectangles, but memory is only
+// committed as they get attached
+constexpr size_t MAX_RECTANGLES = 1 << 18;
+
 const char *vertex_shader_source = "#version 330 core\n"
     "layout (location = 0) in vec2 v;\n"
     "void main()\n"
@@ -18,15 +35,64 @@ const char *fragment_shader_source = "#version 330 core\n"
     "   colour = vec4(0.0f, 1.0f, 0.0f, 1.0f);\n"
     "}\0";
 
-CollisionManager::CollisionManager(size_t num_rectangles) {
-  size_t alloc_size = num_rectangles *
-      (sizeof(flux_id) + sizeof(collison_rectangle_t) + sizeof(rectangle_t));
-  memory_manager.allocMemory(alloc_size);
-  rect_bounds_.claimMemory(&memory_manager, num_rectangles);
-  rect_bounds_ids_.claimMemory(&memory_manager, num_rectangles);
-  rect_vertex_.claimMemory(&memory_manager, num_rectangles);
+CollisionManager::CollisionManager(EntityRegistry &registry, size_t num_rectangles,
+                                   broadphase_t broadphase, float cell_size,
+                                   FrameArena *frame_arena)
+    : registry_(&registry), transform_pool_(&registry.pool<transform_t>()),
+      query_tree_(QUERY_TREE_MARGIN), broadphase_(broadphase), spatial_hash_(cell_size),
+      static_hash_(cell_size), static_dirty_(false), num_checked_rects_(0), tilemap_(nullptr),
+      tilemap_entity_(0), job_system_(nullptr), thread_data_(1), frame_arena_(frame_arena),
+      shader_program_(0), rect_vertex_buff_(0), rect_index_buff_(0), rect_vertex_array_(0),
+      num_indexed_rects_(0), num_uploaded_rects_(0) {
+  // every array is cache line aligned, so leave room for each one's padding.
+  // Arrays start out with room for num_rectangles and grow in place from there
+  size_t max_rectangles = std::max(num_rectangles, MAX_RECTANGLES);
+  size_t reserve_size = ComponentArray<flux_id>::claimSize(max_rectangles) +
+                        decltype(rect_bounds_)::claimSize(max_rectangles) +
+                        ComponentArray<rectangle_t>::claimSize(max_rectangles) +
+                        ComponentArray<float>::claimSize(max_rectangles) * SAT_NUM_STREAMS +
+                        ComponentArray<aabb_t>::claimSize(max_rectangles) +
+                        ComponentArray<bool>::claimSize(max_rectangles) +
+                        ComponentArray<collision_filter_t>::claimSize(max_rectangles) +
+                        ComponentArray<uint32_t>::claimSize(max_rectangles) +
+                        ComponentArray<int32_t>::claimSize(max_rectangles);
+  if (!memory_manager.reserveMemory(reserve_size))
+    throw std::runtime_error("Failed to reserve collision memory");
+  // tagged by what the arrays are for, so memory stats show where it goes
+  memory_tag_t collider_tag = memory_manager.registerTag("colliders");
+  memory_tag_t cache_tag = memory_manager.registerTag("collider cache");
+  memory_tag_t query_tag = memory_manager.registerTag("query tree");
+  size_t initial = num_rectangles;
+  bool reserved =
+      rect_bounds_.reserveMemory(&memory_manager, max_rectangles, initial,
+                                 COMPONENT_ALIGNMENT, collider_tag) &&
+      rect_bounds_ids_.reserveMemory(&memory_manager, max_rectangles, initial,
+                                     COMPONENT_ALIGNMENT, collider_tag) &&
+      rect_vertex_.reserveMemory(&memory_manager, max_rectangles, initial,
+                                 COMPONENT_ALIGNMENT, cache_tag) &&
+      rect_aabbs_.reserveMemory(&memory_manager, max_rectangles, initial,
+                                COMPONENT_ALIGNMENT, cache_tag) &&
+      rect_static_.reserveMemory(&memory_manager, max_rectangles, initial,
+                                 COMPONENT_ALIGNMENT, collider_tag) &&
+      rect_filter_.reserveMemory(&memory_manager, max_rectangles, initial,
+                                 COMPONENT_ALIGNMENT, collider_tag) &&
+      rect_next_.reserveMemory(&memory_manager, max_rectangles, initial,
+                               COMPONENT_ALIGNMENT, collider_tag) &&
+      rect_proxy_.reserveMemory(&memory_manager, max_rectangles, initial,
+                                COMPONENT_ALIGNMENT, query_tag);
+  for (auto &stream : rect_sat_)
+    reserved = reserved && stream.reserveMemory(&memory_manager, max_rectangles, initial,
+                                                COMPONENT_ALIGNMENT, cache_tag);
+  if (!reserved)
+    throw std::runtime_error("Failed to reserve collision arrays");
+  registry_->onRemove<collider_t>([this](flux_id entity) { removeRectangles(entity); });
+}
 
-  // ----- OpenGL setup -----
+CollisionManager::~CollisionManager() {
+  registry_->onRemove<collider_t>(nullptr);
+}
+
+void CollisionManager::initGL() {
   // compile shaders and create program
   int success;
   GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
@@ -56,13 +122,32 @@ CollisionManager::CollisionManager(size_t num_rectangles) {
   glDeleteShader(fragment_shader);
 
   // setup vertex buffers amd arrays
-  GLuint idxs_buff;
   glGenBuffers(1, &rect_vertex_buff_);
-  glGenBuffers(1, &idxs_buff);
+  glGenBuffers(1, &rect_index_buff_);
   glGenVertexArrays(1, &rect_vertex_array_);
-  
-  // construct index array
-  unsigned int *vert_idxs = new unsigned int[num_rectangles * 6];
+
+  glBindVertexArray(rect_vertex_array_);
+  glBindBuffer(GL_ARRAY_BUFFER, rect_vertex_buff_);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rect_index_buff_);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+  glEnableVertexAttribArray(0);
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+// every rectangle is drawn as the same two triangles, so the index buffer only
+// changes when there are more rectangles than it covers
+void CollisionManager::uploadIndices(size_t num_rectangles) {
+  // construct index array, it only has to live until it's uploaded
+  std::vector<unsigned int> heap_idxs;
+  unsigned int *vert_idxs =
+      frame_arena_ ? frame_arena_->tryAlloc<unsigned int>(num_rectangles * 6) : nullptr;
+  if (!vert_idxs) {
+    heap_idxs.resize(num_rectangles * 6);
+    vert_idxs = heap_idxs.data();
+  }
   for (size_t i = 0; i < num_rectangles * 6; i += 6) {
     unsigned int start_vert = ((unsigned int)i / 6) * 4; // four vertices per rect 
     vert_idxs[i] = start_vert;
@@ -74,132 +159,772 @@ CollisionManager::CollisionManager(size_t num_rectangles) {
   }
 
   glBindVertexArray(rect_vertex_array_);
-  glBindBuffer(GL_ARRAY_BUFFER, rect_vertex_buff_);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, idxs_buff);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * num_rectangles * 6,
                vert_idxs, GL_STATIC_DRAW);
-  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-  glEnableVertexAttribArray(0);
-
   glBindVertexArray(0);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-  delete[] vert_idxs;
-}
-
-bool CollisionManager::attachRectangle(flux_id entity_id, transform_t entity_trans,
-                                       Vector2D from_entity, float height, float width) {
-  collison_rectangle_t rect_bounds;
-  rect_bounds.trans = entity_trans.trans;
-  rect_bounds.sin_rot = entity_trans.sin_rot;
-  rect_bounds.cos_rot = entity_trans.cos_rot;
-  rect_bounds.from_entity = from_entity;
-  rect_bounds.height = height;
-  rect_bounds.width = height;
-  bool success = rect_bounds_.emplace(rect_bounds) &&
-                 rect_bounds_ids_.emplace(entity_id);
-  return success;
-}
-
-// TODO (wraftus) should we check if any rectangles go without udpating translation,
-// or should we only update those that need updating?
-void CollisionManager::udpateTranslations(flux_id* trans_id_buff, transform_t *trans_buff,
-                                          size_t trans_size) {
-  // update entities transform data for rectangles
+  num_indexed_rects_ = num_rectangles;
+}
+
+bool CollisionManager::attachRectangle(flux_id entity_id, Vector2D from_entity, float height,
+                                       float width, bool is_static, uint32_t layer,
+                                       uint32_t mask) {
+  if (!registry_->alive(entity_id))
+    return false;
+
+  // cached data gets filled in by the next updateCache. Every stream has to
+  // stay the same size, so if one can't grow the ones before it are popped
+  uint32_t rect_idx = (uint32_t)rect_bounds_.size();
+  bool success = rect_bounds_.emplace(from_entity, height, width) &&
+                 rect_bounds_ids_.emplace(entity_id) &&
+                 rect_vertex_.emplace(rectangle_t()) &&
+                 rect_aabbs_.emplace(aabb_t()) &&
+                 rect_static_.emplace(is_static) &&
+                 rect_filter_.emplace(collision_filter_t{layer, mask}) &&
+                 rect_proxy_.emplace(AABBTree::NULL_NODE) &&
+                 rect_next_.emplace(SparseSet::INVALID_IDX);
+  for (auto &stream : rect_sat_)
+    success = success && stream.emplace(0.0f);
+  collider_t *collider = nullptr;
+  if (success) {
+    collider = registry_->get<collider_t>(entity_id);
+    if (!collider)
+      collider = registry_->emplace(entity_id, collider_t{SparseSet::INVALID_IDX});
+  }
+  if (!collider) {
+    truncateAll(rect_idx, rect_proxy_, rect_bounds_ids_, rect_bounds_, rect_next_,
+                rect_vertex_, rect_sat_, rect_aabbs_, rect_static_, rect_filter_);
+    return false;
+  }
+
+  // link the new rectangle in at the front of the entity's list
+  rect_next_.buffer_[rect_idx] = collider->first_rect;
+  collider->first_rect = rect_idx;
+  static_dirty_ |= is_static;
+  return true;
+}
+
+bool CollisionManager::detachRectangles(flux_id entity_id) {
+  // the registry calls back into removeRectangles
+  return registry_->remove<collider_t>(entity_id);
+}
+
+void CollisionManager::removeRectangles(flux_id entity_id) {
+  // removing a rectangle moves the last one into its place, so remove the
+  // highest first. The last rectangle is then never one still to be removed
+  detach_scratch_.clear();
+  for (uint32_t rect_idx = registry_->get<collider_t>(entity_id)->first_rect;
+       rect_idx != SparseSet::INVALID_IDX; rect_idx = rect_next_.buffer_[rect_idx])
+    detach_scratch_.push_back(rect_idx);
+  std::sort(detach_scratch_.begin(), detach_scratch_.end(), std::greater<uint32_t>());
+  for (uint32_t rect_idx : detach_scratch_)
+    removeRectangle(rect_idx);
+}
+
+void CollisionManager::removeRectangle(uint32_t rect_idx) {
+  if (rect_proxy_.buffer_[rect_idx] != AABBTree::NULL_NODE)
+    query_tree_.destroyProxy(rect_proxy_.buffer_[rect_idx]);
+
+  // point whatever referred to the last rectangle at the slot it's moving to
+  uint32_t last = (uint32_t)rect_bounds_.size() - 1;
+  if (last != rect_idx) {
+    uint32_t *next_buff = rect_next_.buffer_;
+    uint32_t &first = registry_->get<collider_t>(rect_bounds_ids_.buffer_[last])->first_rect;
+    if (first == last) {
+      first = rect_idx;
+    } else {
+      uint32_t cur = first;
+      while (next_buff[cur] != last)
+        cur = next_buff[cur];
+      next_buff[cur] = rect_idx;
+    }
+    if (rect_proxy_.buffer_[last] != AABBTree::NULL_NODE)
+      query_tree_.setUserData(rect_proxy_.buffer_[last], rect_idx);
+  }
+  // contacts and the broadphases are fixed up for every move at once in the
+  // next checkCollisions
+  static_dirty_ |= rect_static_.buffer_[rect_idx];
+  rect_moves_.push_back(std::make_pair(rect_idx, last));
+  removeSwapAll(rect_idx, rect_proxy_, rect_bounds_ids_, rect_bounds_, rect_next_, rect_vertex_,
+                rect_sat_, rect_aabbs_, rect_static_, rect_filter_);
+}
+
+void CollisionManager::remapRectangles() {
+  // replay the removals to find where each rectangle of the last
+  // checkCollisions ended up. remap_scratch_ holds the old index of whatever
+  // is in each slot, rectangles attached since then don't have one
+  const uint32_t NO_IDX = SparseSet::INVALID_IDX;
+  rect_remap_.resize(num_checked_rects_);
+  remap_scratch_.resize(num_checked_rects_);
+  for (uint32_t idx = 0; idx < num_checked_rects_; idx++)
+    rect_remap_[idx] = remap_scratch_[idx] = idx;
+  for (auto &move : rect_moves_) {
+    uint32_t hole = move.first, last = move.second;
+    remap_scratch_.resize(last + 1, NO_IDX);
+    if (remap_scratch_[hole] != NO_IDX)
+      rect_remap_[remap_scratch_[hole]] = NO_IDX;
+    if (hole != last) {
+      remap_scratch_[hole] = remap_scratch_[last];
+      if (remap_scratch_[hole] != NO_IDX)
+        rect_remap_[remap_scratch_[hole]] = hole;
+    }
+    remap_scratch_.pop_back();
+  }
+  rect_moves_.clear();
+
+  // drop contacts with removed rectangles so they don't get an exit event,
+  // the rest follow their rectangles and get sorted again once
+  size_t kept = 0;
+  for (auto &contact : contacts_) {
+    uint32_t collider1 = rect_remap_[contact.collider1];
+    uint32_t collider2 = rect_remap_[contact.collider2];
+    if (collider1 == NO_IDX || collider2 == NO_IDX)
+      continue;
+    contact.collider1 = collider1;
+    contact.collider2 = collider2;
+    if (collider1 > collider2) {
+      std::swap(contact.collider1, contact.collider2);
+      std::swap(contact.entity1, contact.entity2);
+      contact.axis = -contact.axis;
+    }
+    contacts_[kept++] = contact;
+  }
+  contacts_.resize(kept);
+  std::sort(contacts_.begin(), contacts_.end(),
+            [](const collision_contact_t &c1, const collision_contact_t &c2) {
+              return c1.collider1 < c2.collider1 ||
+                     (c1.collider1 == c2.collider1 && c1.collider2 < c2.collider2);
+            });
+
+  // no static rectangle was removed unless the static grid is being rebuilt
+  // anyway, so the grid only needs to know where its rectangles went
+  if (!static_dirty_) {
+    for (auto &static_idx : static_idxs_)
+      static_idx = rect_remap_[static_idx];
+  }
+
+  // sweep and prune tracks positions in the dynamic list, work out where
+  // last frame's positions are in this frame's list
+  if (broadphase_ != BROADPHASE_SWEEP_AND_PRUNE)
+    return;
   size_t rect_size = rect_bounds_.size();
-  flux_id *bound_id_buff = rect_bounds_ids_.buffer_;
-  collison_rectangle_t *bound_buff = rect_bounds_.buffer_;
-  for (size_t trans_idx = 0; trans_idx < trans_size; trans_idx++) {
-    for (size_t rect_idx = 0; rect_idx < rect_size; rect_idx++) {
-      if (bound_id_buff[rect_idx] == trans_id_buff[trans_idx]) {
-        bound_buff[rect_idx].trans = trans_buff[trans_idx].trans;
-        bound_buff[rect_idx].sin_rot = trans_buff[trans_idx].sin_rot;
-        bound_buff[rect_idx].cos_rot = trans_buff[trans_idx].cos_rot;
-        break;
+  bool *static_buffer = rect_static_.buffer_;
+  remap_scratch_.resize(rect_size);
+  uint32_t num_dynamic = 0;
+  for (size_t idx = 0; idx < rect_size; idx++) {
+    remap_scratch_[idx] = num_dynamic;
+    num_dynamic += !static_buffer[idx];
+  }
+  dynamic_remap_.resize(dynamic_idxs_.size());
+  for (size_t i = 0; i < dynamic_idxs_.size(); i++) {
+    uint32_t rect_idx = rect_remap_[dynamic_idxs_[i]];
+    dynamic_remap_[i] =
+        rect_idx == NO_IDX ? SweepAndPrune::REMOVED_IDX : remap_scratch_[rect_idx];
+  }
+  sweep_and_prune_.remap(dynamic_remap_.data());
+}
+
+void CollisionManager::udpateTranslations() {
+  // grouped views line transforms and colliders up in the same dense order,
+  // so the transform dirty bits can be walked directly
+  ComponentArray<transform_t> &transforms = transform_pool_->components();
+  auto view = registry_->view<transform_t, collider_t>();
+  if (view.isGrouped()) {
+    collider_t *collider_buff = view.data<collider_t>();
+    transforms.forEachDirty(0, view.size(),
+                            [&](size_t idx) { markMoved(collider_buff[idx]); });
+  } else {
+    view.each([&](flux_id entity, transform_t &, collider_t &collider) {
+      if (transforms.isDirty(transform_pool_->find(entity)))
+        markMoved(collider);
+    });
+  }
+}
+
+void CollisionManager::markMoved(const collider_t &collider) {
+  uint32_t *next_buff = rect_next_.buffer_;
+  bool *static_buff = rect_static_.buffer_;
+  for (uint32_t rect_idx = collider.first_rect; rect_idx != SparseSet::INVALID_IDX;
+       rect_idx = next_buff[rect_idx]) {
+    rect_bounds_.markDirty(rect_idx);
+    static_dirty_ |= static_buff[rect_idx];
+  }
+}
+
+void CollisionManager::setNumThreads(size_t num_threads) {
+  if (num_threads == 0)
+    num_threads = 1;
+  if (num_threads == thread_data_.size() && job_system_ == owned_job_system_.get())
+    return;
+
+  // the job system is only needed when there is someone to help the caller
+  owned_job_system_.reset(num_threads > 1 ? new JobSystem(num_threads) : nullptr);
+  setJobSystem(owned_job_system_.get());
+}
+
+void CollisionManager::setJobSystem(JobSystem *job_system) {
+  if (job_system != owned_job_system_.get())
+    owned_job_system_.reset();
+  job_system_ = job_system;
+  thread_data_.resize(job_system ? job_system->getNumThreads() : 1);
+}
+
+void CollisionManager::runParallel(size_t num_tasks,
+                                   const std::function<void(size_t, size_t)> &task) {
+  if (job_system_) {
+    job_system_->parallelFor(num_tasks, task);
+  } else {
+    for (size_t i = 0; i < num_tasks; i++)
+      task(i, 0);
+  }
+}
+
+void CollisionManager::updateCache() {
+  if (job_system_) {
+    job_system_->parallelFor(rect_vertex_, CACHE_CHUNK_SIZE,
+                             [this](size_t begin, size_t end, size_t) {
+                               updateCacheRange(begin, end);
+                             });
+  } else {
+    updateCacheRange(0, rect_bounds_.size());
+  }
+  updateQueryTree();
+}
+
+// done on one thread after the cache is built, so the tree always ends up
+// the same shape no matter how the cache was split up
+void CollisionManager::updateQueryTree() {
+  size_t rect_size = rect_bounds_.size();
+  aabb_t *aabb_buffer = rect_aabbs_.buffer_;
+  int32_t *proxy_buffer = rect_proxy_.buffer_;
+  rect_bounds_.forEachDirty(0, rect_size, [&](size_t idx) {
+    if (proxy_buffer[idx] == AABBTree::NULL_NODE)
+      proxy_buffer[idx] = query_tree_.createProxy(aabb_buffer[idx], (uint32_t)idx);
+    else
+      query_tree_.moveProxy(proxy_buffer[idx], aabb_buffer[idx]);
+  });
+  rect_bounds_.clearDirty();
+}
+
+void CollisionManager::updateCacheRange(size_t begin, size_t end) {
+  // get all buffer data we need, transforms are read straight out of the
+  // registry
+  flux_id *id_buffer = rect_bounds_ids_.buffer_;
+  transform_t *trans_buffer = transform_pool_->data();
+  Vector2D *from_entity_buffer = rect_bounds_.data<rect_from_entity_field_t>();
+  float *height_buffer = rect_bounds_.data<rect_height_field_t>();
+  float *width_buffer = rect_bounds_.data<rect_width_field_t>();
+  aabb_t *aabb_buffer = rect_aabbs_.buffer_;
+  float *sat_buffer[SAT_NUM_STREAMS];
+  for (int i = 0; i < SAT_NUM_STREAMS; i++)
+    sat_buffer[i] = rect_sat_[i].buffer_;
+
+  // each dirty rectangle's corners go into the batch in local space, in the
+  // same order as rectangle_t, with its transform repeated for every corner
+  const size_t max_corners = CACHE_BATCH_SIZE * 4;
+  uint32_t batch_idxs[CACHE_BATCH_SIZE];
+  float local_x[max_corners], local_y[max_corners];
+  float cos_rot[max_corners], sin_rot[max_corners];
+  float trans_x[max_corners], trans_y[max_corners];
+  float world_x[max_corners], world_y[max_corners];
+  size_t batch_size = 0;
+
+  auto flushBatch = [&]() {
+    batch::rotateTranslate(local_x, local_y, cos_rot, sin_rot, trans_x, trans_y,
+                           batch_size * 4, world_x, world_y);
+    for (size_t i = 0; i < batch_size; i++) {
+      uint32_t idx = batch_idxs[i];
+      float *corners_x = world_x + i * 4;
+      float *corners_y = world_y + i * 4;
+      rectangle_t &verts = rect_vertex_.modify(idx);
+      verts.v1 = Vector2D(corners_x[0], corners_y[0]);
+      verts.v2 = Vector2D(corners_x[1], corners_y[1]);
+      verts.v3 = Vector2D(corners_x[2], corners_y[2]);
+      verts.v4 = Vector2D(corners_x[3], corners_y[3]);
+      aabb_buffer[idx] = getBoundingBox(verts);
+
+      // the face normals are just the rectangle's rotated local axes
+      Vector2D axis1(-sin_rot[i * 4], cos_rot[i * 4]);
+      Vector2D axis2(cos_rot[i * 4], sin_rot[i * 4]);
+      float min1 = INFINITY, max1 = -INFINITY, min2 = INFINITY, max2 = -INFINITY;
+      batch::dotMinMax(corners_x, corners_y, 4, axis1, nullptr, min1, max1);
+      batch::dotMinMax(corners_x, corners_y, 4, axis2, nullptr, min2, max2);
+
+      // scatter everything into the SoA streams for the narrowphase
+      for (int corner = 0; corner < 4; corner++) {
+        sat_buffer[SAT_V1_X + 2 * corner][idx] = corners_x[corner];
+        sat_buffer[SAT_V1_Y + 2 * corner][idx] = corners_y[corner];
       }
+      sat_buffer[SAT_AXIS1_X][idx] = axis1.x;
+      sat_buffer[SAT_AXIS1_Y][idx] = axis1.y;
+      sat_buffer[SAT_AXIS2_X][idx] = axis2.x;
+      sat_buffer[SAT_AXIS2_Y][idx] = axis2.y;
+      sat_buffer[SAT_MIN1][idx] = min1;
+      sat_buffer[SAT_MAX1][idx] = max1;
+      sat_buffer[SAT_MIN2][idx] = min2;
+      sat_buffer[SAT_MAX2][idx] = max2;
     }
-  }
+    batch_size = 0;
+  };
+
+  // transform each moved rectangle once, so the narrowphase and debug drawing
+  // can share the results. The job system splits rect_vertex_ on multiples of
+  // 64, so threads never share a word of its dirty bits
+  rect_bounds_.forEachDirty(begin, end, [&](size_t idx) {
+    uint32_t trans_idx = transform_pool_->find(id_buffer[idx]);
+    transform_t trans =
+        trans_idx == SparseSet::INVALID_IDX ? transform_t() : trans_buffer[trans_idx];
+    float half_width = width_buffer[idx] / 2, half_height = height_buffer[idx] / 2;
+    Vector2D from_entity = from_entity_buffer[idx];
+    Vector2D corners[4] = {Vector2D(half_width, half_height) + from_entity,
+                           Vector2D(-half_width, half_height) + from_entity,
+                           Vector2D(-half_width, -half_height) + from_entity,
+                           Vector2D(half_width, -half_height) + from_entity};
+
+    size_t first = batch_size * 4;
+    for (int corner = 0; corner < 4; corner++) {
+      local_x[first + corner] = corners[corner].x;
+      local_y[first + corner] = corners[corner].y;
+      cos_rot[first + corner] = trans.cos_rot;
+      sin_rot[first + corner] = trans.sin_rot;
+      trans_x[first + corner] = trans.trans.x;
+      trans_y[first + corner] = trans.trans.y;
+    }
+    batch_idxs[batch_size++] = (uint32_t)idx;
+    if (batch_size == CACHE_BATCH_SIZE)
+      flushBatch();
+  });
+  flushBatch();
 }
 
 void CollisionManager::checkCollisions() {
-  // get all size and buffer data we need
-  size_t rect_size = rect_bounds_.size();
+  updateCache();
+  if (!rect_moves_.empty())
+    remapRectangles();
+  updatePartition();
+  num_checked_rects_ = rect_bounds_.size();
+  findCandidatePairs();
+
+  // group candidates by their first rectangle, so each one can be tested
+  // against a whole batch of others at once
+  std::sort(candidate_pairs_.begin(), candidate_pairs_.end(),
+            [](const collision_pair_t &p1, const collision_pair_t &p2) {
+              return p1.a < p2.a || (p1.a == p2.a && p1.b < p2.b);
+            });
+
+  // each thread writes contacts into its own buffer, and remembers which
+  // chunk they came from so they can be stitched back together in order
+  size_t num_pairs = candidate_pairs_.size();
+  size_t num_chunks = (num_pairs + NARROWPHASE_CHUNK_SIZE - 1) / NARROWPHASE_CHUNK_SIZE;
+  chunk_results_.resize(num_chunks);
+  for (auto &thread_data : thread_data_)
+    thread_data.contacts.clear();
+  runParallel(num_chunks, [&](size_t chunk, size_t thread_idx) {
+    thread_data_t &thread_data = thread_data_[thread_idx];
+    size_t begin = chunk * NARROWPHASE_CHUNK_SIZE;
+    chunk_results_[chunk].thread_idx = thread_idx;
+    chunk_results_[chunk].begin = thread_data.contacts.size();
+    narrowphaseRange(begin, std::min(begin + NARROWPHASE_CHUNK_SIZE, num_pairs),
+                     thread_data);
+    chunk_results_[chunk].end = thread_data.contacts.size();
+  });
+
+  // keep last frames contacts around to diff against
+  contacts_.swap(prev_contacts_);
+  contacts_.clear();
+  for (auto &result : chunk_results_) {
+    std::vector<collision_contact_t> &contacts = thread_data_[result.thread_idx].contacts;
+    contacts_.insert(contacts_.end(), contacts.begin() + result.begin,
+                     contacts.begin() + result.end);
+  }
+  updateEvents();
+  checkTilemap();
+}
+
+void CollisionManager::setTilemap(TilemapCollider *tilemap, flux_id entity_id,
+                                  uint32_t layer, uint32_t mask) {
+  tilemap_ = tilemap;
+  tilemap_entity_ = entity_id;
+  tilemap_filter_ = collision_filter_t{layer, mask};
+  tile_contacts_.clear();
+  if (tilemap_ && !tilemap_->isMerged())
+    tilemap_->mergeSolidTiles();
+}
+
+// same chunking as the narrowphase, but over dynamic rectangles
+void CollisionManager::checkTilemap() {
+  tile_contacts_.clear();
+  if (!tilemap_)
+    return;
+  // tiles may have been edited since it was set
+  if (!tilemap_->isMerged())
+    tilemap_->mergeSolidTiles();
+
+  size_t num_dynamic = dynamic_idxs_.size();
+  size_t num_chunks = (num_dynamic + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+  tile_chunk_results_.resize(num_chunks);
+  for (auto &thread_data : thread_data_)
+    thread_data.tile_contacts.clear();
+  runParallel(num_chunks, [&](size_t chunk, size_t thread_idx) {
+    thread_data_t &thread_data = thread_data_[thread_idx];
+    size_t begin = chunk * TILEMAP_CHUNK_SIZE;
+    tile_chunk_results_[chunk].thread_idx = thread_idx;
+    tile_chunk_results_[chunk].begin = thread_data.tile_contacts.size();
+    tilemapRange(begin, std::min(begin + TILEMAP_CHUNK_SIZE, num_dynamic), thread_data);
+    tile_chunk_results_[chunk].end = thread_data.tile_contacts.size();
+  });
+
+  for (auto &result : tile_chunk_results_) {
+    std::vector<collision_contact_t> &contacts =
+        thread_data_[result.thread_idx].tile_contacts;
+    tile_contacts_.insert(tile_contacts_.end(), contacts.begin() + result.begin,
+                          contacts.begin() + result.end);
+  }
+}
+
+void CollisionManager::tilemapRange(size_t begin, size_t end, thread_data_t &thread_data) {
   flux_id *rect_id_buffer = rect_bounds_ids_.buffer_;
-  collison_rectangle_t *rect_buffer = rect_bounds_.buffer_;
-
-  // iterate through all rectangle bounds and check for collisions (using SAT)
-  for (size_t outer_idx = 0; outer_idx < rect_size - 1; outer_idx++) {
-    // preform transform on outer rectangle, get projection vector and range
-    rectangle_t outer_rect(rect_buffer[outer_idx]);
-    Vector2D axis1(-(outer_rect.v1.y - outer_rect.v2.y), // perp to "top" face
-                   outer_rect.v1.x - outer_rect.v2.x);
-    Vector2D axis2(-(outer_rect.v4.y - outer_rect.v1.y), // perp to "right" face
-                   outer_rect.v4.x - outer_rect.v1.x);
-
-    float outer_min1, outer_max1, outer_min2, outer_max2;
-    getProjectionBounds(outer_min1, outer_max1, axis1, outer_rect);
-    getProjectionBounds(outer_min2, outer_max2, axis2, outer_rect);
-    printf("rect1: axis1 %f %f, axis2 %f %f\n", outer_min1, outer_max1, outer_min2,
-           outer_max2);
-
-    // iterate through rectangle bounds, making sure we don't double check collisions
-    for (size_t inner_idx = outer_idx + 1; inner_idx < rect_size; inner_idx++) {
-      // don't compare collision boxes on same entity
-      // TODO(wraftus) probably don't need to do this check everytime
-      if (rect_id_buffer[outer_idx] != rect_id_buffer[inner_idx]) {
-      
-        // preform transform on inner rectangle and get projection ranges
-        rectangle_t inner_rect(rect_buffer[inner_idx]);
-        Vector2D axis3(-(outer_rect.v1.y - outer_rect.v2.y), // perp to "top" face
-                       outer_rect.v1.x - outer_rect.v2.x);
-        Vector2D axis4(-(outer_rect.v1.y - outer_rect.v4.y), // perp to "right" face
-                       outer_rect.v1.x - outer_rect.v4.x);
-
-        // if any projections don't overlap, they aren't colliding
-        float inner_min, inner_max;
-        getProjectionBounds(inner_min, inner_max, axis1, inner_rect);
-        printf("rect2: axis1 %f %f\n", inner_min, inner_max);
-        if (inner_max < outer_min1 || outer_max1 < inner_min)
-          continue;
-
-        getProjectionBounds(inner_min, inner_max, axis2, inner_rect);
-        printf("rect2: axis2 %f %f\n", inner_min, inner_max);
-        if (inner_max < outer_min2 || outer_max2 < inner_min)
-          continue;
-
-        getProjectionBounds(outer_min1, outer_max1, axis3, outer_rect);
-        getProjectionBounds(inner_min, inner_max, axis3, inner_rect);
-        if (inner_max < outer_min1 || outer_max1 < inner_min)
-          continue;
-
-        getProjectionBounds(outer_min2, outer_max2, axis4, outer_rect);
-        getProjectionBounds(inner_min, inner_max, axis4, inner_rect);
-        if (inner_max < outer_min2 || outer_max2 < inner_min)
-          continue;
-
-        // projections colliding on all four axes
-        printf("%d is colliding with %d\n", rect_id_buffer[outer_idx],
-               rect_id_buffer[inner_idx]);
+  collision_filter_t *filter_buffer = rect_filter_.buffer_;
+  sat_streams_t sat_streams;
+  for (int i = 0; i < SAT_NUM_STREAMS; i++)
+    sat_streams.stream[i] = rect_sat_[i].buffer_;
+  const sat_streams_t &box_streams = tilemap_->getSatStreams();
 
-      }
+  std::vector<uint32_t> &boxes = thread_data.tile_boxes;
+  std::vector<uint8_t> &hits = thread_data.tile_hits;
+  for (size_t i = begin; i < end; i++) {
+    uint32_t rect_idx = dynamic_idxs_[i];
+    if (!(filter_buffer[rect_idx].layer & tilemap_filter_.mask) ||
+        !(tilemap_filter_.layer & filter_buffer[rect_idx].mask))
+      continue;
+
+    // only the tiles under the rectangle are looked at
+    boxes.clear();
+    tilemap_->findBoxes(dynamic_aabbs_[i], boxes);
+    if (boxes.empty())
+      continue;
+    std::sort(boxes.begin(), boxes.end());
+
+    hits.resize(boxes.size());
+    satTest(sat_streams, rect_idx, box_streams, boxes.data(), boxes.size(), hits.data());
+    for (size_t j = 0; j < boxes.size(); j++) {
+      if (!hits[j])
+        continue;
+      collision_contact_t contact;
+      contact.entity1 = rect_id_buffer[rect_idx];
+      contact.entity2 = tilemap_entity_;
+      contact.collider1 = rect_idx;
+      contact.collider2 = boxes[j];
+      satPenetration(sat_streams, rect_idx, box_streams, boxes[j], contact.axis,
+                     contact.depth);
+      thread_data.tile_contacts.push_back(contact);
+    }
+  }
+}
+
+void CollisionManager::updateEvents() {
+  // both contact lists are sorted by collider pair, so we can walk them
+  // together like a merge
+  events_.clear();
+  size_t cur_idx = 0, prev_idx = 0;
+  while (cur_idx < contacts_.size() || prev_idx < prev_contacts_.size()) {
+    collision_contact_t *cur = cur_idx < contacts_.size() ? &contacts_[cur_idx] : nullptr;
+    collision_contact_t *prev =
+        prev_idx < prev_contacts_.size() ? &prev_contacts_[prev_idx] : nullptr;
+
+    collision_event_t event;
+    collision_contact_t *source;
+    if (!prev || (cur && (cur->collider1 < prev->collider1 ||
+                          (cur->collider1 == prev->collider1 &&
+                           cur->collider2 < prev->collider2)))) {
+      event.type = COLLISION_ENTER;
+      source = cur;
+      cur_idx++;
+    } else if (!cur || prev->collider1 < cur->collider1 ||
+               (prev->collider1 == cur->collider1 && prev->collider2 < cur->collider2)) {
+      event.type = COLLISION_EXIT;
+      source = prev;
+      prev_idx++;
+    } else {
+      event.type = COLLISION_STAY;
+      source = cur;
+      cur_idx++;
+      prev_idx++;
+    }
+
+    event.entity1 = source->entity1;
+    event.entity2 = source->entity2;
+    event.collider1 = source->collider1;
+    event.collider2 = source->collider2;
+    events_.push_back(event);
+  }
+}
+
+void CollisionManager::narrowphaseRange(size_t begin, size_t end,
+                                        thread_data_t &thread_data) {
+  flux_id *rect_id_buffer = rect_bounds_ids_.buffer_;
+  collision_filter_t *filter_buffer = rect_filter_.buffer_;
+  sat_streams_t sat_streams;
+  for (int i = 0; i < SAT_NUM_STREAMS; i++)
+    sat_streams.stream[i] = rect_sat_[i].buffer_;
+
+  std::vector<uint32_t> &candidate_idxs = thread_data.candidate_idxs;
+  std::vector<uint8_t> &candidate_hits = thread_data.candidate_hits;
+  for (size_t group_start = begin; group_start < end;) {
+    uint32_t outer = candidate_pairs_[group_start].a;
+    candidate_idxs.clear();
+    size_t group_end = group_start;
+    for (; group_end < end && candidate_pairs_[group_end].a == outer; group_end++) {
+      // don't compare collision boxes on same entity, or ones that have
+      // masked each other out
+      uint32_t inner = candidate_pairs_[group_end].b;
+      if (rect_id_buffer[outer] == rect_id_buffer[inner])
+        continue;
+      if (!(filter_buffer[outer].layer & filter_buffer[inner].mask) ||
+          !(filter_buffer[inner].layer & filter_buffer[outer].mask))
+        continue;
+      candidate_idxs.push_back(inner);
+    }
+    group_start = group_end;
+
+    candidate_hits.resize(candidate_idxs.size());
+    satTest(sat_streams, outer, candidate_idxs.data(), candidate_idxs.size(),
+            candidate_hits.data());
+    for (size_t i = 0; i < candidate_idxs.size(); i++) {
+      if (!candidate_hits[i])
+        continue;
+      // hits are rare enough to work out the penetration one at a time
+      collision_contact_t contact;
+      contact.entity1 = rect_id_buffer[outer];
+      contact.entity2 = rect_id_buffer[candidate_idxs[i]];
+      contact.collider1 = outer;
+      contact.collider2 = candidate_idxs[i];
+      satPenetration(sat_streams, outer, candidate_idxs[i], contact.axis, contact.depth);
+      thread_data.contacts.push_back(contact);
     }
   }
 }
 
+void CollisionManager::updatePartition() {
+  size_t rect_size = rect_bounds_.size();
+  aabb_t *aabb_buffer = rect_aabbs_.buffer_;
+  bool *static_buffer = rect_static_.buffer_;
+
+  dynamic_aabbs_.clear();
+  dynamic_idxs_.clear();
+  for (uint32_t idx = 0; idx < rect_size; idx++) {
+    if (static_buffer[idx])
+      continue;
+    dynamic_aabbs_.push_back(aabb_buffer[idx]);
+    dynamic_idxs_.push_back(idx);
+  }
+
+  if (!static_dirty_)
+    return;
+  static_aabbs_.clear();
+  static_idxs_.clear();
+  for (uint32_t idx = 0; idx < rect_size; idx++) {
+    if (!static_buffer[idx])
+      continue;
+    static_aabbs_.push_back(aabb_buffer[idx]);
+    static_idxs_.push_back(idx);
+  }
+  static_hash_.rebuild(static_aabbs_.data(), static_aabbs_.size());
+  static_dirty_ = false;
+}
+
+void CollisionManager::findCandidatePairs() {
+  // only pass on pairs whose world space bounds overlap to the narrowphase
+  candidate_pairs_.clear();
+  size_t num_dynamic = dynamic_aabbs_.size();
+  switch (broadphase_) {
+  case BROADPHASE_ALL_PAIRS:
+    findAllPairs(dynamic_aabbs_.data(), num_dynamic, candidate_pairs_);
+    break;
+  case BROADPHASE_SPATIAL_HASH:
+    spatial_hash_.rebuild(dynamic_aabbs_.data(), num_dynamic);
+    spatial_hash_.findPairs(candidate_pairs_);
+    break;
+  case BROADPHASE_SWEEP_AND_PRUNE:
+    // endpoints stay sorted from last frame, so this is mostly a linear pass.
+    // remapRectangles already moved them to this frame's dynamic list
+    sweep_and_prune_.update(dynamic_aabbs_.data(), num_dynamic);
+    sweep_and_prune_.findPairs(candidate_pairs_);
+    break;
+  }
+  // dynamic_idxs_ is ascending, so mapping back keeps a < b
+  for (auto &pair : candidate_pairs_) {
+    pair.a = dynamic_idxs_[pair.a];
+    pair.b = dynamic_idxs_[pair.b];
+  }
+
+  if (static_aabbs_.empty())
+    return;
+  for (uint32_t i = 0; i < num_dynamic; i++) {
+    static_hits_.clear();
+    static_hash_.query(dynamic_aabbs_[i], static_hits_);
+    uint32_t dynamic_idx = dynamic_idxs_[i];
+    for (uint32_t hit : static_hits_) {
+      uint32_t static_idx = static_idxs_[hit];
+      if (dynamic_idx < static_idx)
+        candidate_pairs_.push_back(collision_pair_t{dynamic_idx, static_idx});
+      else
+        candidate_pairs_.push_back(collision_pair_t{static_idx, dynamic_idx});
+    }
+  }
+}
+
+bool CollisionManager::containsPoint(uint32_t rect_idx, Vector2D point) {
+  return aabb::contains(getLocalBounds(rect_idx), toLocal(rect_idx, point));
+}
+
+// SAT with the region's axes and the rectangle's, the rectangle's world
+// space bounds cover the region's axes
+bool CollisionManager::overlapsRegion(uint32_t rect_idx, const aabb_t &region) {
+  if (!aabb::overlaps(rect_aabbs_.buffer_[rect_idx], region))
+    return false;
+
+  Vector2D corners[4] = {region.min, Vector2D(region.max.x, region.min.y), region.max,
+                         Vector2D(region.min.x, region.max.y)};
+  aabb_t local_region(toLocal(rect_idx, corners[0]), toLocal(rect_idx, corners[0]));
+  for (int i = 1; i < 4; i++) {
+    Vector2D local = toLocal(rect_idx, corners[i]);
+    local_region = aabb::merge(local_region, aabb_t(local, local));
+  }
+  return aabb::overlaps(getLocalBounds(rect_idx), local_region);
+}
+
+void CollisionManager::queryPoints(const Vector2D *points, size_t num_points,
+                                   uint32_t *results, size_t max_results,
+                                   size_t *result_counts) {
+  updateCache();
+  for (size_t i = 0; i < num_points; i++) {
+    uint32_t *query_results = results + i * max_results;
+    size_t &count = result_counts[i];
+    count = 0;
+    aabb_t region(points[i], points[i]);
+    query_tree_.query(region, [&](uint32_t rect_idx) {
+      if (count == max_results)
+        return false;
+      if (containsPoint(rect_idx, points[i]))
+        query_results[count++] = rect_idx;
+      return count < max_results;
+    });
+    std::sort(query_results, query_results + count);
+  }
+}
+
+void CollisionManager::queryRegions(const aabb_t *regions, size_t num_regions,
+                                    uint32_t *results, size_t max_results,
+                                    size_t *result_counts) {
+  updateCache();
+  for (size_t i = 0; i < num_regions; i++) {
+    uint32_t *query_results = results + i * max_results;
+    size_t &count = result_counts[i];
+    count = 0;
+    query_tree_.query(regions[i], [&](uint32_t rect_idx) {
+      if (count == max_results)
+        return false;
+      if (overlapsRegion(rect_idx, regions[i]))
+        query_results[count++] = rect_idx;
+      return count < max_results;
+    });
+    std::sort(query_results, query_results + count);
+  }
+}
+
+void CollisionManager::raycast(const collision_ray_t *rays, size_t num_rays,
+                               raycast_hit_t *hits) {
+  updateCache();
+  for (size_t i = 0; i < num_rays; i++) {
+    const collision_ray_t &ray = rays[i];
+    raycast_hit_t &hit = hits[i];
+    hit.entity = 0;
+    hit.collider = INVALID_COLLIDER;
+    hit.t = ray.max_t;
+    query_tree_.raycast(ray.origin, ray.dir, ray.max_t, [&](uint32_t rect_idx, float max_t) {
+      // in the rectangle's own axes it's just another slab test
+      float t;
+      if (!aabb::raycast(getLocalBounds(rect_idx), toLocal(rect_idx, ray.origin),
+                         toLocal(rect_idx, ray.dir), max_t, t))
+        return max_t;
+      // ties go to the lower collider so the result doesn't depend on the tree
+      if (t < hit.t || (t == hit.t && rect_idx < hit.collider)) {
+        hit.collider = rect_idx;
+        hit.t = t;
+      }
+      return hit.t;
+    });
+    if (hit.collider != INVALID_COLLIDER)
+      hit.entity = rect_bounds_ids_.buffer_[hit.collider];
+  }
+}
+
+void CollisionManager::queryNearest(const Vector2D *points, size_t num_points, size_t k,
+                                    uint32_t *results) {
+  if (k == 0)
+    return;
+  updateCache();
+  for (size_t i = 0; i < num_points; i++) {
+    // best k so far as (distance squared, collider), kept sorted
+    nearest_scratch_.clear();
+    query_tree_.nearest(points[i], [&](uint32_t rect_idx, float bound_dist) {
+      // the fat bounds never overestimate the distance, so once they are
+      // further away than our kth best nothing else can get in
+      if (nearest_scratch_.size() == k && bound_dist > nearest_scratch_.back().first)
+        return false;
+      aabb_t local_bounds = getLocalBounds(rect_idx);
+      std::pair<float, uint32_t> entry(
+          aabb::distanceSquared(local_bounds, toLocal(rect_idx, points[i])), rect_idx);
+      auto pos = std::upper_bound(nearest_scratch_.begin(), nearest_scratch_.end(), entry);
+      if (pos - nearest_scratch_.begin() < (ptrdiff_t)k) {
+        nearest_scratch_.insert(pos, entry);
+        if (nearest_scratch_.size() > k)
+          nearest_scratch_.pop_back();
+      }
+      return true;
+    });
+
+    uint32_t *query_results = results + i * k;
+    for (size_t j = 0; j < k; j++)
+      query_results[j] = j < nearest_scratch_.size() ? nearest_scratch_[j].second
+                                                     : INVALID_COLLIDER;
+  }
+}
+
 void CollisionManager::drawBoundaries() {
+  // nothing touches OpenGL until the first draw, so collisions work without
+  // a context
+  if (!shader_program_)
+    initGL();
   glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
   glUseProgram(shader_program_);
 
-  // draw rectangle collision bounds to the screen
-  size_t num_rect = rect_bounds_.size();
-  collison_rectangle_t *bounds_buff = rect_bounds_.buffer_;
+  // draw rectangle collision bounds to the screen, reusing the vertices from
+  // checkCollisions unless something moved since
+  updateCache();
+  size_t num_rect = rect_vertex_.size();
+  if (num_rect > num_indexed_rects_)
+    uploadIndices(std::max(num_rect, num_indexed_rects_ * 2));
   rectangle_t *vert_buff = rect_vertex_.buffer_;
-  for (size_t i = 0; i < num_rect; i++) {
-    vert_buff[i] = rectangle_t(bounds_buff[i]);
-  }
   glBindBuffer(GL_ARRAY_BUFFER, rect_vertex_buff_);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(rectangle_t) * num_rect, vert_buff,
-               GL_DYNAMIC_DRAW);
+  if (num_rect > num_uploaded_rects_) {
+    // the vertex buffer only gets reallocated when it's too small
+    num_uploaded_rects_ = std::max(num_rect, num_uploaded_rects_ * 2);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(rectangle_t) * num_uploaded_rects_, nullptr,
+                 GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(rectangle_t) * num_rect, vert_buff);
+  } else {
+    // otherwise only re-upload the span of vertices changed since last draw
+    size_t first = SIZE_MAX, last = 0;
+    rect_vertex_.forEachDirty([&](size_t idx) {
+      first = std::min(first, idx);
+      last = idx;
+    });
+    if (first <= last)
+      glBufferSubData(GL_ARRAY_BUFFER, sizeof(rectangle_t) * first,
+                      sizeof(rectangle_t) * (last - first + 1), vert_buff + first);
+  }
+  rect_vertex_.clearDirty();
 
   glBindVertexArray(rect_vertex_array_);
   glDrawElements(GL_TRIANGLES, (GLuint)num_rect * 6, GL_UNSIGNED_INT, 0);
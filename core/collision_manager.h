@@ -2,39 +2,52 @@
 #define COLLISION_MANAGER_H
 
 #include "../data_structres/vectors.h"
+#include "../data_structres/aabb.h"
 #include "../data_structres/component_array.h"
+#include "../data_structres/soa_component_array.h"
+#include "../data_structres/sparse_set.h"
 #include "transform_manager.h"
+#include "aabb_tree.h"
+#include "entity_registry.h"
+#include "broadphase.h"
+#include "frame_arena.h"
+#include "narrowphase.h"
+#include "tilemap_collider.h"
+#include "job_system.h"
 
 #include <glad/glad.h>
 
+#include <memory>
+
 namespace flux {
 
-// collison_rectangle_t is a crisp 32 bytes :)
-struct collison_rectangle_t {
-  collison_rectangle_t() 
-    : sin_rot(0), cos_rot(0), height(0), width(0) {}
-  // copy of entities transform data
-  Vector2D trans;
-  float sin_rot;
-  float cos_rot;
-  
-  // offset and dimensions of rectangular collision bounds
-  Vector2D from_entity;
-  float height;
-  float width;
+// every entity with rectangles attached has one of these in the registry,
+// holding the index of its most recently attached rectangle. The rest of its
+// rectangles are linked from there through the collision manager
+struct collider_t {
+  uint32_t first_rect;
 };
 
+// fields of a rectangle, for storing them as separate streams. They only
+// change when a rectangle is attached, where it ends up in the world comes
+// from its entity's transform_t
+struct rect_from_entity_field_t { typedef Vector2D type; };
+struct rect_height_field_t { typedef float type; };
+struct rect_width_field_t { typedef float type; };
+
 struct rectangle_t {
   rectangle_t() {}
-  inline rectangle_t(collison_rectangle_t &rect) {
-    v1 = (Vector2D(rect.width / 2, rect.height / 2) + rect.from_entity)
-             .rotate(rect.cos_rot, rect.sin_rot) + rect.trans;
-    v2 = (Vector2D(-rect.width / 2, rect.height / 2) + rect.from_entity)
-             .rotate(rect.cos_rot, rect.sin_rot) + rect.trans;
-    v3 = (Vector2D(-rect.width / 2, -rect.height / 2) + rect.from_entity)
-             .rotate(rect.cos_rot, rect.sin_rot) + rect.trans;
-    v4 = (Vector2D(rect.width / 2, -rect.height / 2) + rect.from_entity)
-             .rotate(rect.cos_rot, rect.sin_rot) + rect.trans;
+  // from_entity and the dimensions are in the entity's space
+  inline rectangle_t(const transform_t &trans, Vector2D from_entity, float height,
+                     float width) {
+    v1 = (Vector2D(width / 2, height / 2) + from_entity)
+             .rotate(trans.cos_rot, trans.sin_rot) + trans.trans;
+    v2 = (Vector2D(-width / 2, height / 2) + from_entity)
+             .rotate(trans.cos_rot, trans.sin_rot) + trans.trans;
+    v3 = (Vector2D(-width / 2, -height / 2) + from_entity)
+             .rotate(trans.cos_rot, trans.sin_rot) + trans.trans;
+    v4 = (Vector2D(width / 2, -height / 2) + from_entity)
+             .rotate(trans.cos_rot, trans.sin_rot) + trans.trans;
   }
   Vector2D v1; // Quadrent 1
   Vector2D v2; // Quadrent 2
@@ -42,53 +55,287 @@ struct rectangle_t {
   Vector2D v4; // Quadrent 4
 };
 
+// a pair of colliders is only tested if each one's layer is in the other's
+// mask, so one way filtering (e.g. triggers) is just a matter of masks
+constexpr uint32_t COLLISION_LAYER_DEFAULT = 1;
+constexpr uint32_t COLLISION_MASK_ALL = 0xFFFFFFFF;
+
+struct collision_filter_t {
+  uint32_t layer;
+  uint32_t mask;
+};
+
+// two colliders found overlapping by checkCollisions
+struct collision_contact_t {
+  flux_id entity1;
+  flux_id entity2;
+  // indices of the colliding rectangles, collider1 is always the lower one
+  uint32_t collider1;
+  uint32_t collider2;
+  // unit axis of least penetration, pointing from collider1 towards collider2
+  Vector2D axis;
+  float depth;
+};
+
+enum collision_event_type_t {
+  COLLISION_ENTER, // started overlapping this frame
+  COLLISION_STAY,  // overlapping this frame and last frame
+  COLLISION_EXIT   // overlapped last frame but not this one
+};
+
+struct collision_event_t {
+  collision_event_type_t type;
+  flux_id entity1;
+  flux_id entity2;
+  uint32_t collider1;
+  uint32_t collider2;
+};
+
+// ray origin + t * dir for t in [0, max_t]
+struct collision_ray_t {
+  Vector2D origin;
+  Vector2D dir;
+  float max_t;
+};
+
+struct raycast_hit_t {
+  flux_id entity;
+  uint32_t collider; // INVALID_COLLIDER if the ray didn't hit anything
+  float t;
+};
+
 // TODO(wraftus) should really make this class alot more compact
 class CollisionManager {
 public:
-  CollisionManager(size_t num_rectangles);
+  static constexpr uint32_t INVALID_COLLIDER = 0xFFFFFFFF;
+
+  // rectangles follow their entity's transform_t in the registry, or sit at the
+  // origin if it doesn't have one. num_rectangles is only how many rectangles
+  // to make room for up front, more are made room for as they are attached.
+  // cell_size is the side length of the spatial hash grid cells, and should
+  // be around the size of a typical collider. Scratch for uploading draw data
+  // comes out of frame_arena if there is one, and the GL objects for drawing
+  // are only made by the first drawBoundaries
+  CollisionManager(EntityRegistry &registry, size_t num_rectangles,
+                   broadphase_t broadphase = BROADPHASE_SPATIAL_HASH,
+                   float cell_size = 0.5f, FrameArena *frame_arena = nullptr);
+  ~CollisionManager();
 
   // TODO(wraftus) assign a collision id to each collision bound?
-  bool attachRectangle(flux_id entity_id, transform_t entity_trans,
-                       Vector2D from_entity, float height, float width);
+  // an entity can have any number of rectangles attached to it, and gets a
+  // collider_t in the registry for them. Static rectangles are never tested
+  // against each other, and moving one forces the static broadphase to be
+  // rebuilt, so keep it for things like walls. Fails if entity_id isn't alive
+  bool attachRectangle(flux_id entity_id, Vector2D from_entity, float height, float width,
+                       bool is_static = false, uint32_t layer = COLLISION_LAYER_DEFAULT,
+                       uint32_t mask = COLLISION_MASK_ALL);
+  // removes every rectangle attached to entity_id, in constant time for each
+  // one. The last rectangles are moved into the freed indices, so other
+  // rectangles' indices can change. Contacts with the removed rectangles are
+  // dropped at the next checkCollisions without an exit event. Removing the
+  // entity's collider_t or destroying the entity does the same
+  bool detachRectangles(flux_id entity_id);
 
-  void udpateTranslations(flux_id *flux_buff, transform_t *trans_buffer,
-                          size_t trans_size);
+  // flags the rectangles of every entity whose transform_t is dirty, so the
+  // next cache update moves them using the transforms straight out of the
+  // registry. Should be called once the frame's transforms are final, before
+  // the registry's transform dirty bits are cleared
+  void udpateTranslations();
   void checkCollisions();
   void drawBoundaries();
 
+  // results of the last checkCollisions, both stay valid until the next one.
+  // Collider indices in them are from before any detach since then.
+  // contacts are sorted by collider pair, events are sorted by collider pair
+  // with exits mixed in where the pair would have been
+  inline collision_contact_t *getContacts() { return contacts_.data(); }
+  inline size_t getNumContacts() { return contacts_.size(); }
+  inline collision_event_t *getEvents() { return events_.data(); }
+  inline size_t getNumEvents() { return events_.size(); }
+
+  // collides every dynamic rectangle against the merged boxes of tilemap,
+  // which is merged here if it isn't already. The tilemap isn't owned and has
+  // to stay alive until it is replaced, passing nullptr removes it
+  void setTilemap(TilemapCollider *tilemap, flux_id entity_id,
+                  uint32_t layer = COLLISION_LAYER_DEFAULT,
+                  uint32_t mask = COLLISION_MASK_ALL);
+  // rectangles overlapping the tilemap as of the last checkCollisions. entity2
+  // is the tilemap's entity and collider2 the index of the merged box, with
+  // the axis pointing into the box. Sorted by rectangle then box
+  inline collision_contact_t *getTileContacts() { return tile_contacts_.data(); }
+  inline size_t getNumTileContacts() { return tile_contacts_.size(); }
+
+  // batched spatial queries against the colliders as of the last transform
+  // update. Each query i gets the slice [i * max_results, (i + 1) * max_results)
+  // of results, filled with collider indices sorted in ascending order, and
+  // the number written goes in result_counts[i]. Queries with more than
+  // max_results hits are cut short
+  void queryPoints(const Vector2D *points, size_t num_points, uint32_t *results,
+                   size_t max_results, size_t *result_counts);
+  void queryRegions(const aabb_t *regions, size_t num_regions, uint32_t *results,
+                    size_t max_results, size_t *result_counts);
+  // finds the first collider hit by each ray
+  void raycast(const collision_ray_t *rays, size_t num_rays, raycast_hit_t *hits);
+  // finds the k closest colliders to each point, nearest first. Each point
+  // gets k slots of results, any left over are set to INVALID_COLLIDER
+  void queryNearest(const Vector2D *points, size_t num_points, size_t k,
+                    uint32_t *results);
+  inline flux_id getColliderEntity(uint32_t collider) {
+    return rect_bounds_ids_.buffer_[collider];
+  }
+
+  inline void setCellSize(float cell_size) {
+    spatial_hash_.setCellSize(cell_size);
+    static_hash_.setCellSize(cell_size);
+    static_dirty_ = true;
+  }
+  inline broadphase_t getBroadphase() { return broadphase_; }
+
+  // spreads the vertex cache and narrowphase over num_threads threads (the
+  // caller included), results come out in the same order for any thread count
+  void setNumThreads(size_t num_threads);
+  // same, but sharing a job system owned by someone else
+  void setJobSystem(JobSystem *job_system);
+  inline size_t getNumThreads() { return thread_data_.size(); }
+
+  // for looking at memory stats, the rectangle arrays live in here
+  inline MemoryManager &getMemoryManager() { return memory_manager; }
+
 private:
   MemoryManager memory_manager;
+  EntityRegistry *registry_;
+  ComponentPool<transform_t> *transform_pool_;
   // TODO(wraftus) store the buffer pointers & size somewhere more cache friendly
   ComponentArray<flux_id> rect_bounds_ids_;
-  ComponentArray<collison_rectangle_t> rect_bounds_;
+  SoAComponentArray<rect_from_entity_field_t, rect_height_field_t, rect_width_field_t>
+      rect_bounds_;
+
+  // each rectangle links to the next one on the same entity, starting from
+  // the entity's collider_t
+  ComponentArray<uint32_t> rect_next_;
+  std::vector<uint32_t> detach_scratch_;
+
+  // world space data, only recomputed for dirty rectangles by updateCache
   ComponentArray<rectangle_t> rect_vertex_;
+  ComponentArray<float> rect_sat_[SAT_NUM_STREAMS];
+  ComponentArray<aabb_t> rect_aabbs_;
+  ComponentArray<bool> rect_static_;
+  ComponentArray<collision_filter_t> rect_filter_;
+
+  // fattened bounds of every rectangle for spatial queries, only dirty
+  // rectangles that left their fat bounds get reinserted
+  AABBTree query_tree_;
+  ComponentArray<int32_t> rect_proxy_;
+  std::vector<std::pair<float, uint32_t>> nearest_scratch_;
 
+  broadphase_t broadphase_;
+  SpatialHash spatial_hash_;
+  SweepAndPrune sweep_and_prune_;
+  std::vector<collision_pair_t> candidate_pairs_;
+
+  // the broadphase above only ever sees dynamic rectangles, gathered into
+  // dynamic_aabbs_ each frame with dynamic_idxs_ mapping back to rectangles.
+  // Static ones get their own grid that is only rebuilt when one of them is
+  // added, removed or moved, and dynamic rectangles are looked up in it
+  std::vector<aabb_t> dynamic_aabbs_;
+  std::vector<uint32_t> dynamic_idxs_;
+  std::vector<aabb_t> static_aabbs_;
+  std::vector<uint32_t> static_idxs_;
+  SpatialHash static_hash_;
+  bool static_dirty_;
+  std::vector<uint32_t> static_hits_;
+
+  // every removal since the last checkCollisions as (freed index, index of
+  // the rectangle moved into it). Contacts and the broadphases still use the
+  // indices from num_checked_rects_ rectangles ago, and remapRectangles fixes
+  // them all up in one pass
+  std::vector<std::pair<uint32_t, uint32_t>> rect_moves_;
+  size_t num_checked_rects_;
+  std::vector<uint32_t> rect_remap_;
+  std::vector<uint32_t> remap_scratch_;
+  std::vector<uint32_t> dynamic_remap_;
+
+  TilemapCollider *tilemap_;
+  flux_id tilemap_entity_;
+  collision_filter_t tilemap_filter_;
+
+  // scratch and output buffers owned by a single thread
+  struct thread_data_t {
+    std::vector<uint32_t> candidate_idxs;
+    std::vector<uint8_t> candidate_hits;
+    std::vector<collision_contact_t> contacts;
+    std::vector<uint32_t> tile_boxes;
+    std::vector<uint8_t> tile_hits;
+    std::vector<collision_contact_t> tile_contacts;
+  };
+  // where the contacts found for a chunk of candidate pairs ended up
+  struct chunk_result_t {
+    size_t thread_idx;
+    size_t begin;
+    size_t end;
+  };
+  JobSystem *job_system_;
+  std::unique_ptr<JobSystem> owned_job_system_;
+  std::vector<thread_data_t> thread_data_;
+  std::vector<chunk_result_t> chunk_results_;
+  std::vector<chunk_result_t> tile_chunk_results_;
+  // all of these keep their capacity between frames, so once they have grown
+  // to fit the scene checkCollisions doesn't allocate
+  std::vector<collision_contact_t> contacts_;
+  std::vector<collision_contact_t> prev_contacts_;
+  std::vector<collision_event_t> events_;
+  std::vector<collision_contact_t> tile_contacts_;
+
+  FrameArena *frame_arena_;
   GLuint shader_program_;
   GLuint rect_vertex_buff_;
+  GLuint rect_index_buff_;
   GLuint rect_vertex_array_;
+  size_t num_indexed_rects_;
+  size_t num_uploaded_rects_;
 
-  inline static void getProjectionBounds(float &min, float &max, Vector2D &axis,
-                                        rectangle_t &rect) {
-    float proj;
-    min = max = vector::dot(axis, rect.v1);
-
-    proj = vector::dot(axis, rect.v2);
-    if (proj < min)
-      min = proj;
-    else if (proj > max)
-      max = proj;
-
-    proj = vector::dot(axis, rect.v3);
-    if (proj < min)
-      min = proj;
-    else if (proj > max)
-      max = proj;
-
-    proj = vector::dot(axis, rect.v4);
-    if (proj < min)
-      min = proj;
-    else if (proj > max)
-      max = proj;
+  void initGL();
+  void uploadIndices(size_t num_rectangles);
+  void removeRectangles(flux_id entity_id);
+  void removeRectangle(uint32_t rect_idx);
+  void remapRectangles();
+  void markMoved(const collider_t &collider);
+  void updateCache();
+  void updateEvents();
+  void updateCacheRange(size_t begin, size_t end);
+  void updateQueryTree();
+  void updatePartition();
+  void findCandidatePairs();
+  bool containsPoint(uint32_t rect_idx, Vector2D point);
+  bool overlapsRegion(uint32_t rect_idx, const aabb_t &region);
+  void narrowphaseRange(size_t begin, size_t end, thread_data_t &thread_data);
+  void checkTilemap();
+  void tilemapRange(size_t begin, size_t end, thread_data_t &thread_data);
+  void runParallel(size_t num_tasks, const std::function<void(size_t, size_t)> &task);
+
+  inline static aabb_t getBoundingBox(rectangle_t &rect) {
+    aabb_t bounds(rect.v1, rect.v1);
+    Vector2D *verts[3] = {&rect.v2, &rect.v3, &rect.v4};
+    for (Vector2D *vert : verts) {
+      bounds.min = Vector2D(fminf(bounds.min.x, vert->x), fminf(bounds.min.y, vert->y));
+      bounds.max = Vector2D(fmaxf(bounds.max.x, vert->x), fmaxf(bounds.max.y, vert->y));
+    }
+    return bounds;
+  }
+
+  // bounds of a rectangle in its own (axis1, axis2) space, where it is just
+  // an axis aligned box
+  inline aabb_t getLocalBounds(uint32_t rect_idx) {
+    return aabb_t(Vector2D(rect_sat_[SAT_MIN1].buffer_[rect_idx],
+                           rect_sat_[SAT_MIN2].buffer_[rect_idx]),
+                  Vector2D(rect_sat_[SAT_MAX1].buffer_[rect_idx],
+                           rect_sat_[SAT_MAX2].buffer_[rect_idx]));
+  }
+  inline Vector2D toLocal(uint32_t rect_idx, Vector2D vec) {
+    return Vector2D(rect_sat_[SAT_AXIS1_X].buffer_[rect_idx] * vec.x +
+                        rect_sat_[SAT_AXIS1_Y].buffer_[rect_idx] * vec.y,
+                    rect_sat_[SAT_AXIS2_X].buffer_[rect_idx] * vec.x +
+                        rect_sat_[SAT_AXIS2_Y].buffer_[rect_idx] * vec.y);
   }
 };
 
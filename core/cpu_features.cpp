@@ -0,0 +1,75 @@
+#include "cpu_features.h"
+
+#if FLUX_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace flux {
+namespace cpu {
+
+#if FLUX_X86
+static void cpuid(unsigned int leaf, unsigned int sub_leaf, unsigned int regs[4]) {
+#if defined(_MSC_VER)
+  int tmp[4];
+  __cpuidex(tmp, (int)leaf, (int)sub_leaf);
+  for (int i = 0; i < 4; i++)
+    regs[i] = (unsigned int)tmp[i];
+#else
+  __cpuid_count(leaf, sub_leaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static unsigned long long xgetbv() {
+#if defined(_MSC_VER)
+  return _xgetbv(0);
+#else
+  unsigned int eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+
+static simd_level_t detectSimdLevel() {
+  unsigned int regs[4]; // eax, ebx, ecx, edx
+  cpuid(0, 0, regs);
+  unsigned int max_leaf = regs[0];
+
+  cpuid(1, 0, regs);
+  if (!(regs[3] & (1u << 26)))
+    return SIMD_SCALAR;
+
+  // AVX needs the cpu support and the OS to save the ymm registers
+  bool os_xsave = (regs[2] & (1u << 27)) != 0;
+  bool has_avx = (regs[2] & (1u << 28)) != 0;
+  if (!os_xsave || !has_avx || max_leaf < 7)
+    return SIMD_SSE2;
+  unsigned long long xcr0 = xgetbv();
+  if ((xcr0 & 0x6) != 0x6)
+    return SIMD_SSE2;
+
+  cpuid(7, 0, regs);
+  if (!(regs[1] & (1u << 5)))
+    return SIMD_SSE2;
+
+  // AVX-512 also needs the opmask and upper zmm state saved
+  if (!(regs[1] & (1u << 16)) || (xcr0 & 0xE6) != 0xE6)
+    return SIMD_AVX2;
+  return SIMD_AVX512;
+}
+#else
+static simd_level_t detectSimdLevel() {
+  return SIMD_SCALAR;
+}
+#endif
+
+simd_level_t getSimdLevel() {
+  static simd_level_t level = detectSimdLevel();
+  return level;
+}
+
+}
+} // namespace flux
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// ----- SIMD build helpers -----
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FLUX_X86 1
+#else
+#define FLUX_X86 0
+#endif
+
+// MSVC lets any function use any intrinsic, but gcc/clang need to be told
+// which functions are allowed to use instructions past the build's baseline
+#if FLUX_X86 && (defined(__GNUC__) || defined(__clang__))
+#define FLUX_TARGET_SSE2 __attribute__((target("sse2")))
+#define FLUX_TARGET_AVX2 __attribute__((target("avx2")))
+#define FLUX_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define FLUX_TARGET_SSE2
+#define FLUX_TARGET_AVX2
+#define FLUX_TARGET_AVX512
+#endif
+// ------------------------------
+
+namespace flux {
+
+enum simd_level_t {
+  SIMD_SCALAR,
+  SIMD_SSE2,
+  SIMD_AVX2,
+  SIMD_AVX512
+};
+
+namespace cpu {
+
+// checked once on first call, includes checking the OS saves the wider
+// registers on context switches
+simd_level_t getSimdLevel();
+
+inline bool hasSSE2() { return getSimdLevel() >= SIMD_SSE2; }
+inline bool hasAVX2() { return getSimdLevel() >= SIMD_AVX2; }
+inline bool hasAVX512() { return getSimdLevel() >= SIMD_AVX512; }
+
+}
+
+} // namespace flux
+
+#endif // CPU_FEATURES_H
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "entity_registry.h"
+
+#include <algorithm>
+
+namespace flux {
+
+void ComponentPoolBase::swapDense(uint32_t idx1, uint32_t idx2) {
+  if (idx1 == idx2)
+    return;
+  flux_id entity = entities_.buffer_[idx1];
+  entities_.modify(idx1) = entities_.buffer_[idx2];
+  entities_.modify(idx2) = entity;
+  entities_idx_.swap(idx1, idx2);
+  swapComponents(idx1, idx2);
+}
+
+void ComponentPoolBase::removeDense(uint32_t idx) {
+  uint32_t last = (uint32_t)entities_.size() - 1;
+  swapDense(idx, last);
+  entities_idx_.remove(HandleMap::getIndex(entities_.buffer_[last]));
+  entities_.removeSwap(last);
+  popComponent();
+}
+
+size_t EntityRegistry::nextTypeIdx() {
+  static size_t next_type_idx = 0;
+  return next_type_idx++;
+}
+
+flux_id EntityRegistry::create() {
+  // no pool could hold any more components than this anyway
+  if (entity_ids_.size() == max_entities_)
+    return 0;
+  return entity_ids_.create();
+}
+
+bool EntityRegistry::destroy(flux_id entity) {
+  if (!alive(entity))
+    return false;
+  for (auto &pool : pools_) {
+    if (pool)
+      removeComponent(*pool, entity);
+  }
+  entity_ids_.remove(entity);
+  return true;
+}
+
+entity_group_t *EntityRegistry::getGroup(const std::vector<size_t> &type_idxs) {
+  std::vector<size_t> sorted_idxs = type_idxs;
+  std::sort(sorted_idxs.begin(), sorted_idxs.end());
+  for (auto &group : groups_) {
+    if (group->type_idxs == sorted_idxs)
+      return group.get();
+  }
+
+  // each pool can only be kept sorted for one group
+  for (size_t type_idx : sorted_idxs) {
+    if (pools_[type_idx]->group_)
+      return nullptr;
+  }
+  groups_.emplace_back(new entity_group_t{sorted_idxs, 0});
+  entity_group_t &group = *groups_.back();
+  ComponentPoolBase *smallest = pools_[sorted_idxs[0]].get();
+  for (size_t type_idx : sorted_idxs) {
+    pools_[type_idx]->group_ = &group;
+    if (pools_[type_idx]->size() < smallest->size())
+      smallest = pools_[type_idx].get();
+  }
+
+  // pack in everything that already has all the components. Anything that
+  // gets swapped past i has already been looked at
+  for (size_t i = 0; i < smallest->size(); i++)
+    addToGroup(group, smallest->entities()[i]);
+  return &group;
+}
+
+void EntityRegistry::addToGroup(entity_group_t &group, flux_id entity) {
+  for (size_t type_idx : group.type_idxs) {
+    uint32_t idx = pools_[type_idx]->find(entity);
+    if (idx == SparseSet::INVALID_IDX || idx < group.size)
+      return;
+  }
+  for (size_t type_idx : group.type_idxs) {
+    ComponentPoolBase &pool = *pools_[type_idx];
+    pool.swapDense(pool.find(entity), (uint32_t)group.size);
+  }
+  group.size++;
+}
+
+void EntityRegistry::removeFromGroup(entity_group_t &group, flux_id entity) {
+  group.size--;
+  for (size_t type_idx : group.type_idxs) {
+    ComponentPoolBase &pool = *pools_[type_idx];
+    pool.swapDense(pool.find(entity), (uint32_t)group.size);
+  }
+}
+
+bool EntityRegistry::removeComponent(ComponentPoolBase &pool, flux_id entity) {
+  if (pool.find(entity) == SparseSet::INVALID_IDX)
+    return false;
+  if (pool.on_remove_)
+    pool.on_remove_(entity);
+  // out of the group first, so the swap below can't pull a grouped entity
+  // out of the packed range
+  uint32_t idx = pool.find(entity);
+  if (pool.group_ && idx < pool.group_->size)
+    removeFromGroup(*pool.group_, entity);
+  pool.removeDense(pool.find(entity));
+  return true;
+}
+
+} // namespace flux
@@ -0,0 +1,271 @@
+#ifndef ENTITY_REGISTRY_H
+#define ENTITY_REGISTRY_H
+
+#include "../data_structres/component_array.h"
+#include "../data_structres/handle_map.h"
+#include "../data_structres/sparse_set.h"
+#include "memory_manager.h"
+
+#include <functional>
+#include <memory>
+#include <stdint.h>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace flux {
+
+// entities that have every component of a view are kept packed at the front
+// of each of the view's pools, in the same order, so a view can walk them
+// all together without looking anything up
+struct entity_group_t {
+  std::vector<size_t> type_idxs;
+  size_t size;
+};
+
+// the type independent half of a pool, so the registry can move and remove
+// components without knowing their type
+class ComponentPoolBase {
+public:
+  ComponentPoolBase() : group_(nullptr) {}
+  virtual ~ComponentPoolBase() {}
+
+  inline size_t size() { return entities_.size(); }
+  // every entity with this component, in the same order as the components
+  inline flux_id *entities() { return entities_.buffer_; }
+  inline uint32_t find(flux_id entity) {
+    return entities_idx_.find(HandleMap::getIndex(entity));
+  }
+
+protected:
+  friend class EntityRegistry;
+
+  // has to outlive every array in the pool, so it lives down here
+  MemoryManager memory_manager_;
+  // keyed by entity index, values are indices into entities_ and the
+  // components
+  SparseSet entities_idx_;
+  ComponentArray<flux_id> entities_;
+  entity_group_t *group_;
+  std::function<void(flux_id)> on_remove_;
+
+  void swapDense(uint32_t idx1, uint32_t idx2);
+  void removeDense(uint32_t idx);
+  virtual void swapComponents(uint32_t idx1, uint32_t idx2) = 0;
+  virtual void popComponent() = 0;
+};
+
+// one of these per component type, the components live in a ComponentArray so
+// they keep their dirty bits
+template <class T> class ComponentPool : public ComponentPoolBase {
+public:
+  ComponentPool(size_t max_entities) {
+    if (!memory_manager_.reserveMemory(ComponentArray<flux_id>::claimSize(max_entities) +
+                                       ComponentArray<T>::claimSize(max_entities)) ||
+        !entities_.reserveMemory(&memory_manager_, max_entities) ||
+        !components_.reserveMemory(&memory_manager_, max_entities))
+      throw std::runtime_error("Failed to reserve component pool memory");
+  }
+
+  inline T *data() { return components_.buffer_; }
+  inline ComponentArray<T> &components() { return components_; }
+
+private:
+  friend class EntityRegistry;
+
+  ComponentArray<T> components_;
+
+  void swapComponents(uint32_t idx1, uint32_t idx2) override {
+    T component = components_.buffer_[idx1];
+    components_.modify(idx1) = components_.buffer_[idx2];
+    components_.modify(idx2) = component;
+  }
+  void popComponent() override { components_.removeSwap(components_.size() - 1); }
+};
+
+// iteration over every entity with all of Ts. Grouped views walk their
+// pools' packed fronts together without looking anything up. Views that
+// couldn't be grouped walk the smallest pool instead, checking each entity
+// against the other pools
+template <class... Ts> class EntityView {
+public:
+  // entities() and data() only line up for grouped views. A single pool is
+  // always packed, so it counts as grouped
+  inline bool isGrouped() { return sizeof...(Ts) == 1 || group_size_ != SIZE_MAX; }
+  // counts matches for views that aren't grouped
+  inline size_t size() {
+    if (isGrouped())
+      return group_size_;
+    size_t size = 0;
+    each([&](flux_id, Ts &...) { size++; });
+    return size;
+  }
+  inline flux_id *entities() { return std::get<0>(pools_)->entities(); }
+  template <class T> inline T *data() { return std::get<ComponentPool<T> *>(pools_)->data(); }
+
+  // calls func(entity, Ts &...) for every entity in the view. Components
+  // written through the references aren't marked dirty
+  template <class F> inline void each(F func) {
+    if (isGrouped()) {
+      flux_id *entity_buff = entities();
+      for (size_t i = 0; i < group_size_; i++)
+        func(entity_buff[i], std::get<ComponentPool<Ts> *>(pools_)->data()[i]...);
+      return;
+    }
+    flux_id *entity_buff = smallest_->entities();
+    size_t num_entities = smallest_->size();
+    for (size_t i = 0; i < num_entities; i++) {
+      flux_id entity = entity_buff[i];
+      uint32_t idxs[] = {std::get<ComponentPool<Ts> *>(pools_)->find(entity)...};
+      bool matches = true;
+      for (uint32_t idx : idxs)
+        matches &= idx != SparseSet::INVALID_IDX;
+      if (matches)
+        callWith(func, entity, idxs, std::index_sequence_for<Ts...>());
+    }
+  }
+
+private:
+  friend class EntityRegistry;
+  EntityView(size_t group_size, ComponentPoolBase *smallest, ComponentPool<Ts> *...pools)
+      : group_size_(group_size), smallest_(smallest), pools_(pools...) {}
+
+  // SIZE_MAX if the view isn't grouped
+  size_t group_size_;
+  ComponentPoolBase *smallest_;
+  std::tuple<ComponentPool<Ts> *...> pools_;
+
+  template <class F, size_t... I>
+  inline void callWith(F &func, flux_id entity, const uint32_t *idxs, std::index_sequence<I...>) {
+    func(entity, std::get<I>(pools_)->data()[idxs[I]]...);
+  }
+};
+
+// hands out generational entity ids, so a destroyed entity's id never
+// matches a new one, and keeps one pool of components per component type.
+// Pools are created the first time their type is used, each with room for
+// max_entities components. Systems that keep more per entity than a component
+// (TransformManager, CollisionManager) own a component in here as well, and
+// hook its removal so destroying an entity cleans up after it everywhere
+class EntityRegistry {
+public:
+  EntityRegistry(size_t max_entities) : max_entities_(max_entities) {}
+
+  // ids are never 0
+  flux_id create();
+  // removes all of entity's components too
+  bool destroy(flux_id entity);
+  inline bool alive(flux_id entity) { return entity_ids_.contains(entity); }
+  inline size_t size() { return entity_ids_.size(); }
+
+  // adds component to entity, or overwrites it if it already has one.
+  // Returns nullptr if entity isn't alive or the pool is full. The pointer
+  // is only good until a component of the same type is added or removed
+  template <class T> inline T *emplace(flux_id entity, const T &component) {
+    if (!alive(entity))
+      return nullptr;
+    ComponentPool<T> &components = pool<T>();
+    uint32_t idx = components.find(entity);
+    if (idx != SparseSet::INVALID_IDX) {
+      components.components_.modify(idx) = component;
+      return &components.components_.buffer_[idx];
+    }
+    if (!components.entities_.emplace(entity))
+      return nullptr;
+    if (!components.components_.emplace(component)) {
+      components.entities_.removeSwap(components.entities_.size() - 1);
+      return nullptr;
+    }
+    components.entities_idx_.insert(HandleMap::getIndex(entity));
+    if (components.group_)
+      addToGroup(*components.group_, entity);
+    idx = components.find(entity);
+    return &components.components_.buffer_[idx];
+  }
+  template <class T> inline bool remove(flux_id entity) {
+    return alive(entity) && removeComponent(pool<T>(), entity);
+  }
+  template <class T> inline bool has(flux_id entity) {
+    return alive(entity) && pool<T>().find(entity) != SparseSet::INVALID_IDX;
+  }
+  // nullptr if entity doesn't have a T
+  template <class T> inline T *get(flux_id entity) {
+    if (!alive(entity))
+      return nullptr;
+    ComponentPool<T> &components = pool<T>();
+    uint32_t idx = components.find(entity);
+    return idx == SparseSet::INVALID_IDX ? nullptr : &components.components_.buffer_[idx];
+  }
+  // same as get, but marks the component dirty
+  template <class T> inline T *modify(flux_id entity) {
+    if (!alive(entity))
+      return nullptr;
+    ComponentPool<T> &components = pool<T>();
+    uint32_t idx = components.find(entity);
+    return idx == SparseSet::INVALID_IDX ? nullptr : &components.components_.modify(idx);
+  }
+
+  // callback gets the entity just before its T is removed, whether through
+  // remove or destroy, while the entity and its T are still there. Only one
+  // per type, passing nullptr clears it
+  template <class T> inline void onRemove(std::function<void(flux_id)> callback) {
+    pool<T>().on_remove_ = std::move(callback);
+  }
+
+  // for once every system has seen this frame's changes
+  template <class T> inline void clearDirty() { pool<T>().components().clearDirty(); }
+
+  template <class T> inline ComponentPool<T> &pool() {
+    size_t type_idx = typeIdx<T>();
+    if (type_idx >= pools_.size())
+      pools_.resize(type_idx + 1);
+    if (!pools_[type_idx])
+      pools_[type_idx].reset(new ComponentPool<T>(max_entities_));
+    return static_cast<ComponentPool<T> &>(*pools_[type_idx]);
+  }
+
+  // every entity with all of Ts. Views over more than one type group their
+  // pools the first time they're asked for, after which the pools are kept
+  // sorted as components come and go. A pool can only be in one group, so a
+  // view sharing a type with another group falls back to lookups instead
+  template <class... Ts> inline EntityView<Ts...> view() {
+    std::tuple<ComponentPool<Ts> *...> pools(&pool<Ts>()...);
+    ComponentPoolBase *smallest = std::get<0>(pools);
+    size_t sizes[] = {std::get<ComponentPool<Ts> *>(pools)->size()...};
+    ComponentPoolBase *bases[] = {std::get<ComponentPool<Ts> *>(pools)...};
+    for (size_t i = 0; i < sizeof...(Ts); i++) {
+      if (sizes[i] < smallest->size())
+        smallest = bases[i];
+    }
+    size_t group_size = smallest->size();
+    if (sizeof...(Ts) > 1) {
+      entity_group_t *group = getGroup({typeIdx<Ts>()...});
+      group_size = group ? group->size : SIZE_MAX;
+    }
+    return EntityView<Ts...>(group_size, smallest,
+                             std::get<ComponentPool<Ts> *>(pools)...);
+  }
+
+private:
+  size_t max_entities_;
+  HandleMap entity_ids_;
+  std::vector<std::unique_ptr<ComponentPoolBase>> pools_;
+  std::vector<std::unique_ptr<entity_group_t>> groups_;
+
+  static size_t nextTypeIdx();
+  template <class T> inline static size_t typeIdx() {
+    static size_t type_idx = nextTypeIdx();
+    return type_idx;
+  }
+
+  // nullptr if one of the pools is already in a different group
+  entity_group_t *getGroup(const std::vector<size_t> &type_idxs);
+  void addToGroup(entity_group_t &group, flux_id entity);
+  void removeFromGroup(entity_group_t &group, flux_id entity);
+  bool removeComponent(ComponentPoolBase &pool, flux_id entity);
+};
+
+} // namespace flux
+
+#endif // ENTITY_REGISTRY_H
@@ -1,10 +1,18 @@
 #include "flux_core.h"
 #include "collision_manager.h"
 
+#include <algorithm>
 #include <stdexcept>
 
 namespace flux {
-FluxCore::FluxCore() {
+
+constexpr size_t FRAME_ARENA_SIZE = 8 * 1024 * 1024;
+constexpr size_t MAX_ENTITIES = 1 << 18;
+
+FluxCore::FluxCore()
+    : frame_arena_(FRAME_ARENA_SIZE),
+      job_system_(std::max(std::thread::hardware_concurrency(), 1u)),
+      registry_(MAX_ENTITIES), transform_manager_(MAX_ENTITIES, &frame_arena_, &registry_) {
   // ----- Window/OpenGL Setup -----
   // initialize GLFW
   if (!glfwInit())
@@ -33,9 +41,19 @@ FluxCore::FluxCore() {
   glfwSetFramebufferSizeCallback(glfw_window_, framebufferSizeCallback);
   //glfwSwapInterval(true);
   
-  collision_manager_ = new CollisionManager(2);
-  collision_manager_->attachRectangle(1, transform_t{}, Vector2D(0, 0), 0.5, 0.5);
-  collision_manager_->attachRectangle(2, transform_t{}, Vector2D(0.25, 0.25), 0.5, 0.5);
+  collision_manager_ =
+      new CollisionManager(registry_, 2, BROADPHASE_SPATIAL_HASH, 0.5f, &frame_arena_);
+  collision_manager_->setJobSystem(&job_system_);
+  flux_id entity1 = registry_.create();
+  flux_id entity2 = registry_.create();
+  transform_manager_.attachToEntity(entity1, Vector2D(0, 0), 0.0f);
+  transform_manager_.attachToEntity(entity2, Vector2D(0, 0), 0.0f);
+  collision_manager_->attachRectangle(entity1, Vector2D(0, 0), 0.5, 0.5);
+  collision_manager_->attachRectangle(entity2, Vector2D(0.25, 0.25), 0.5, 0.5);
+  transform_manager_.updateWorld();
+  collision_manager_->udpateTranslations();
+  registry_.clearDirty<transform_t>();
+  transform_manager_.clearDirty();
   collision_manager_->checkCollisions();
 }
 
@@ -46,12 +64,21 @@ FluxCore::~FluxCore() {
 
 void FluxCore::run() {
   while (!glfwWindowShouldClose(glfw_window_)) {
+    frame_arena_.reset();
+    // world transforms have to be up to date before collision reads them
+    transform_manager_.updateWorld();
+    collision_manager_->udpateTranslations();
+    registry_.clearDirty<transform_t>();
+    transform_manager_.clearDirty();
+
     // clear screen and swap buffers
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
     collision_manager_->drawBoundaries();
     glfwSwapBuffers(glfw_window_);
     glfwPollEvents();
+
+    collision_manager_->getMemoryManager().recordFrame();
   }
 }
 
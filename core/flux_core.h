@@ -2,6 +2,10 @@
 #define FLUX_CORE_H
 
 #include "collision_manager.h"
+#include "entity_registry.h"
+#include "frame_arena.h"
+#include "job_system.h"
+#include "transform_manager.h"
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -15,10 +19,24 @@ public:
 
   void run();
 
+  // scratch memory for the current frame, reset at the top of every frame
+  inline FrameArena &getFrameArena() { return frame_arena_; }
+  // shared by every system that splits its work across threads
+  inline JobSystem &getJobSystem() { return job_system_; }
+  inline EntityRegistry &getRegistry() { return registry_; }
+  // every entity's local transform and hierarchy, the world transforms it
+  // works out end up in the registry's transform_t for everything else
+  inline TransformManager &getTransformManager() { return transform_manager_; }
+
 private:
   int window_width_, window_height_;
   GLFWwindow *glfw_window_;
 
+  FrameArena frame_arena_;
+  JobSystem job_system_;
+  EntityRegistry registry_;
+  TransformManager transform_manager_;
+
   CollisionManager *collision_manager_;
 
   // TODO(wraftus) this should also change window_width_ and _height_
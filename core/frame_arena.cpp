@@ -0,0 +1,58 @@
+#include "frame_arena.h"
+
+#include <stdexcept>
+#include <stdint.h>
+#include <string.h>
+
+namespace flux {
+
+FrameArena::FrameArena(size_t capacity)
+    : start_(nullptr), capacity_(capacity), used_(0), last_frame_used_(0),
+      high_water_(0) {
+  // the backing block is always cache line aligned, so claiming all of it
+  // never needs padding
+  if (!memory_manager_.allocMemory(capacity))
+    throw std::runtime_error("Failed to allocate frame arena");
+  start_ = static_cast<char *>(memory_manager_.claimSection(
+      capacity, section_id_, 64, memory_manager_.registerTag("frame arena")));
+  if (!start_)
+    throw std::runtime_error("Failed to claim frame arena");
+}
+
+void FrameArena::reset() {
+#ifndef NDEBUG
+  memset(start_, 0xCD, used_);
+#endif
+  last_frame_used_ = used_;
+  used_ = 0;
+}
+
+void *FrameArena::allocBytes(size_t size, size_t alignment) {
+  void *ptr = tryAllocBytes(size, alignment);
+#ifndef NDEBUG
+  if (!ptr)
+    throw std::overflow_error("FrameArena ran out of space");
+#endif
+  return ptr;
+}
+
+void *FrameArena::tryAllocBytes(size_t size, size_t alignment) {
+  if (!fits(size, alignment))
+    return nullptr;
+
+  uintptr_t address = reinterpret_cast<uintptr_t>(start_) + used_;
+  size_t padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+  void *ptr = start_ + used_ + padding;
+  used_ += padding + size;
+  if (used_ > high_water_)
+    high_water_ = used_;
+  return ptr;
+}
+
+bool FrameArena::fits(size_t size, size_t alignment) {
+  uintptr_t address = reinterpret_cast<uintptr_t>(start_) + used_;
+  size_t padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+  return size <= capacity_ - used_ && padding <= capacity_ - used_ - size;
+}
+
+} // namespace flux
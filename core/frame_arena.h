@@ -0,0 +1,60 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include "memory_manager.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace flux {
+
+// bump pointer allocator for anything that only has to live until the end of
+// the frame. Nothing is ever freed on its own, reset() throws away everything
+// at once. In debug builds running out of space throws and reset memory is
+// scribbled over, so anything holding on past a reset shows up quickly
+class FrameArena {
+public:
+  FrameArena(size_t capacity);
+
+  // starts a new frame, every pointer handed out before this is invalid
+  void reset();
+
+  // returns nullptr (or throws in debug builds) if the arena is full, for
+  // callers that have nothing to fall back on
+  void *allocBytes(size_t size, size_t alignment = alignof(max_align_t));
+  template <class T> inline T *alloc(size_t count) {
+    if (count > SIZE_MAX / sizeof(T))
+      return static_cast<T *>(allocBytes(SIZE_MAX, alignof(T)));
+    return static_cast<T *>(allocBytes(sizeof(T) * count, alignof(T)));
+  }
+  // same, but always returns nullptr when full, for callers with a fallback
+  void *tryAllocBytes(size_t size, size_t alignment = alignof(max_align_t));
+  template <class T> inline T *tryAlloc(size_t count) {
+    if (count > SIZE_MAX / sizeof(T))
+      return nullptr;
+    return static_cast<T *>(tryAllocBytes(sizeof(T) * count, alignof(T)));
+  }
+  // whether an allocation of size would succeed right now
+  bool fits(size_t size, size_t alignment = alignof(max_align_t));
+
+  inline size_t getCapacity() { return capacity_; }
+  // bytes handed out so far this frame, padding included
+  inline size_t getUsed() { return used_; }
+  // how much the last frame used before it was reset
+  inline size_t getLastFrameUsed() { return last_frame_used_; }
+  // most any single frame has used
+  inline size_t getHighWater() { return high_water_; }
+
+private:
+  MemoryManager memory_manager_;
+  flux_id section_id_;
+  char *start_;
+  size_t capacity_;
+  size_t used_;
+  size_t last_frame_used_;
+  size_t high_water_;
+};
+
+} // namespace flux
+
+#endif // FRAME_ARENA_H
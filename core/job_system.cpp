@@ -0,0 +1,186 @@
+#include "job_system.h"
+
+namespace flux {
+
+// lets a thread find its own queue
+static thread_local JobSystem *tls_job_system = nullptr;
+static thread_local size_t tls_thread_idx = 0;
+
+JobSystem::JobSystem(size_t num_threads) {
+  num_queued_ = 0;
+  stopping_ = false;
+  if (num_threads == 0)
+    num_threads = 1;
+  for (size_t i = 0; i < num_threads; i++) {
+    workers_.emplace_back(new worker_t);
+    workers_.back()->jobs_run = 0;
+    workers_.back()->steals = 0;
+    workers_.back()->failed_steals = 0;
+  }
+
+  // the calling thread is always thread 0
+  for (size_t i = 1; i < num_threads; i++)
+    threads_.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stopping_ = true;
+  }
+  sleep_cv_.notify_all();
+  for (auto &thread : threads_)
+    thread.join();
+}
+
+size_t JobSystem::getThreadIdx() {
+  return tls_job_system == this ? tls_thread_idx : 0;
+}
+
+void JobSystem::run(job_func_t func, JobCounter *counter, JobCounter *after) {
+  // counted straight away, so waiting on counter covers jobs still waiting
+  // on after
+  if (counter)
+    counter->pending_++;
+  job_t job{std::move(func), counter};
+  if (after) {
+    std::lock_guard<std::mutex> lock(after->mutex_);
+    if (after->pending_ > 0) {
+      after->waiting_.push_back(std::move(job));
+      return;
+    }
+  }
+  pushJob(getThreadIdx(), std::move(job));
+}
+
+void JobSystem::wait(JobCounter &counter) {
+  size_t thread_idx = getThreadIdx();
+  while (!counter.isDone()) {
+    if (!runJob(thread_idx))
+      std::this_thread::yield();
+  }
+  // the last job to finish may still be holding the lock, and the counter
+  // can't go out of scope until it lets go
+  std::lock_guard<std::mutex> lock(counter.mutex_);
+}
+
+void JobSystem::parallelFor(size_t num_tasks,
+                            const std::function<void(size_t, size_t)> &task) {
+  // not worth queueing anything for
+  if (threads_.empty() || num_tasks <= 1) {
+    size_t thread_idx = getThreadIdx();
+    for (size_t i = 0; i < num_tasks; i++)
+      task(i, thread_idx);
+    return;
+  }
+
+  JobCounter counter;
+  for (size_t i = 0; i < num_tasks; i++)
+    run([&task, i](size_t thread_idx) { task(i, thread_idx); }, &counter);
+  wait(counter);
+}
+
+job_stats_t JobSystem::getStats(size_t thread_idx) {
+  worker_t &worker = *workers_[thread_idx];
+  return job_stats_t{worker.jobs_run, worker.steals, worker.failed_steals};
+}
+
+job_stats_t JobSystem::getTotalStats() {
+  job_stats_t total = {0, 0, 0};
+  for (size_t i = 0; i < workers_.size(); i++) {
+    job_stats_t stats = getStats(i);
+    total.jobs_run += stats.jobs_run;
+    total.steals += stats.steals;
+    total.failed_steals += stats.failed_steals;
+  }
+  return total;
+}
+
+void JobSystem::resetStats() {
+  for (auto &worker : workers_) {
+    worker->jobs_run = 0;
+    worker->steals = 0;
+    worker->failed_steals = 0;
+  }
+}
+
+void JobSystem::workerLoop(size_t thread_idx) {
+  tls_job_system = this;
+  tls_thread_idx = thread_idx;
+  while (true) {
+    if (runJob(thread_idx))
+      continue;
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    sleep_cv_.wait(lock, [this] { return stopping_ || num_queued_ > 0; });
+    if (stopping_)
+      return;
+  }
+}
+
+void JobSystem::pushJob(size_t thread_idx, job_t &&job) {
+  // counted before it's queued so it can't be taken first. Taking the lock
+  // makes sure a worker can't miss the wake up between checking num_queued_
+  // and going to sleep
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    num_queued_++;
+  }
+  {
+    std::lock_guard<std::mutex> lock(workers_[thread_idx]->mutex);
+    workers_[thread_idx]->jobs.push_back(std::move(job));
+  }
+  sleep_cv_.notify_one();
+}
+
+bool JobSystem::runJob(size_t thread_idx) {
+  // newest job from our own queue first, since its data is most likely to
+  // still be in cache, otherwise the oldest job from someone else's
+  job_t job;
+  bool found = false;
+  worker_t &worker = *workers_[thread_idx];
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (!worker.jobs.empty()) {
+      job = std::move(worker.jobs.back());
+      worker.jobs.pop_back();
+      found = true;
+    }
+  }
+  for (size_t i = 1; !found && i < workers_.size(); i++) {
+    worker_t &victim = *workers_[(thread_idx + i) % workers_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.jobs.empty()) {
+      job = std::move(victim.jobs.front());
+      victim.jobs.pop_front();
+      found = true;
+      worker.steals.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  if (!found) {
+    if (workers_.size() > 1)
+      worker.failed_steals.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  num_queued_--;
+  job.func(thread_idx);
+  worker.jobs_run.fetch_add(1, std::memory_order_relaxed);
+  if (job.counter)
+    finishJob(job.counter);
+  return true;
+}
+
+void JobSystem::finishJob(JobCounter *counter) {
+  // anything waiting on the counter gets queued once it reaches zero
+  std::vector<job_t> ready;
+  {
+    std::lock_guard<std::mutex> lock(counter->mutex_);
+    if (--counter->pending_ == 0)
+      ready.swap(counter->waiting_);
+  }
+  size_t thread_idx = getThreadIdx();
+  for (auto &job : ready)
+    pushJob(thread_idx, std::move(job));
+}
+
+} // namespace flux
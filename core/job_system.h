@@ -0,0 +1,118 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include "../data_structres/component_array.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace flux {
+
+// jobs get the index of the thread running them
+typedef std::function<void(size_t)> job_func_t;
+
+class JobCounter;
+
+struct job_t {
+  job_func_t func;
+  JobCounter *counter;
+};
+
+struct job_stats_t {
+  size_t jobs_run;
+  // jobs taken from the front of another thread's queue
+  size_t steals;
+  // times a thread went through every other queue and found nothing
+  size_t failed_steals;
+};
+
+// counts jobs that haven't finished yet. Other jobs can be queued to run once
+// it gets back to zero, which is how dependencies between jobs are expressed
+class JobCounter {
+public:
+  JobCounter() : pending_(0) {}
+  JobCounter(const JobCounter &) = delete;
+  JobCounter &operator=(const JobCounter &) = delete;
+
+  inline bool isDone() { return pending_.load(std::memory_order_acquire) == 0; }
+
+private:
+  friend class JobSystem;
+  std::atomic<size_t> pending_;
+  std::mutex mutex_;
+  std::vector<job_t> waiting_;
+};
+
+// work stealing scheduler, every thread has its own queue of jobs that it
+// takes from the back of, and idle threads steal from the front of the others
+class JobSystem {
+public:
+  // num_threads includes the calling thread, which only runs jobs while it is
+  // waiting on them
+  JobSystem(size_t num_threads);
+  ~JobSystem();
+
+  inline size_t getNumThreads() { return workers_.size(); }
+  // index of the calling thread, anything that isn't one of the workers
+  // counts as thread 0
+  size_t getThreadIdx();
+
+  // queues func, counting it in counter if given. If after is given the job
+  // only gets queued once after's jobs have all finished
+  void run(job_func_t func, JobCounter *counter = nullptr, JobCounter *after = nullptr);
+  // runs queued jobs on the calling thread until counter's jobs are finished
+  void wait(JobCounter &counter);
+
+  // runs task(task_idx, thread_idx) for every task_idx in [0, num_tasks) and
+  // blocks until they are all done
+  void parallelFor(size_t num_tasks, const std::function<void(size_t, size_t)> &task);
+  // runs task(begin, end, thread_idx) over array in chunks of at least
+  // min_chunk components. Chunks are rounded up to a multiple of 64, so two
+  // chunks never write to the same cache line or word of the dirty bits
+  template <class T, class F>
+  inline void parallelFor(ComponentArray<T> &array, size_t min_chunk, F task) {
+    size_t chunk_size = (std::max(min_chunk, (size_t)1) + 63) & ~(size_t)63;
+    size_t size = array.size();
+    parallelFor((size + chunk_size - 1) / chunk_size, [&](size_t chunk, size_t thread_idx) {
+      size_t begin = chunk * chunk_size;
+      task(begin, std::min(begin + chunk_size, size), thread_idx);
+    });
+  }
+
+  job_stats_t getStats(size_t thread_idx);
+  job_stats_t getTotalStats();
+  void resetStats();
+
+private:
+  struct worker_t {
+    std::mutex mutex;
+    std::deque<job_t> jobs;
+    std::atomic<size_t> jobs_run;
+    std::atomic<size_t> steals;
+    std::atomic<size_t> failed_steals;
+  };
+  std::vector<std::unique_ptr<worker_t>> workers_;
+  std::vector<std::thread> threads_;
+
+  // idle workers sleep until something gets queued
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cv_;
+  std::atomic<size_t> num_queued_;
+  bool stopping_;
+
+  void workerLoop(size_t thread_idx);
+  void pushJob(size_t thread_idx, job_t &&job);
+  bool runJob(size_t thread_idx);
+  void finishJob(JobCounter *counter);
+};
+
+} // namespace flux
+
+#endif // JOB_SYSTEM_H
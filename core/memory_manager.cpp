@@ -1,103 +1,646 @@
 #include "memory_manager.h"
+#include "../data_structres/bit_ops.h"
 
+#include <chrono>
 #include <stdexcept>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 namespace flux {
 
-constexpr size_t MAX_SEGMENTS = 100;
-MemoryManager::MemoryManager() {
-  // allocate memory asked for, and reserve space for the max num of mem nodes
+// every block starts on a cache line
+constexpr size_t BLOCK_ALIGNMENT = 64;
+// only bother with huge pages once a block can fill at least one
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// adds the time between its construction and destruction onto total
+struct scoped_timer_t {
+  scoped_timer_t(uint64_t &total) : total(total), start(std::chrono::steady_clock::now()) {}
+  ~scoped_timer_t() {
+    total += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now() - start)
+                 .count();
+  }
+  uint64_t &total;
+  std::chrono::steady_clock::time_point start;
+};
+
+MemoryManager::MemoryManager() : stats_(), num_frames_(0) {
   ALLOC_SIZE_ = 0;
   claimed_ = 0;
+  committed_ = 0;
+  num_sections_ = 0;
+  num_free_blocks_ = 0;
   start_ptr_ = nullptr;
-  segments_.reserve(MAX_SEGMENTS);
-  cur_id_ = 1;
+  huge_pages_ = false;
+  virtual_alloc_ = false;
+  reserved_ = false;
+#if defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  page_size_ = info.dwPageSize;
+#else
+  page_size_ = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+  first_block_ = NULL_SLOT;
+  unused_slots_ = NULL_SLOT;
+  resetFreeLists();
+  registerTag("untagged");
 }
 
 MemoryManager::~MemoryManager() {
   // free the memory we allcoated
-  if (start_ptr_)
+  if (!start_ptr_)
+    return;
+#if defined(_WIN32)
+  if (virtual_alloc_)
+    VirtualFree(start_ptr_, 0, MEM_RELEASE);
+  else
+    _aligned_free(start_ptr_);
+#else
+  if (reserved_)
+    munmap(start_ptr_, ALLOC_SIZE_);
+  else
     free(start_ptr_);
+#endif
 }
 
-bool MemoryManager::allocMemory(const size_t alloc_size) {
+bool MemoryManager::allocMemory(const size_t alloc_size, bool huge_pages) {
   if (start_ptr_ || alloc_size == 0)
     return false;
-  start_ptr_ = malloc(alloc_size);
+
+  huge_pages = huge_pages && alloc_size >= HUGE_PAGE_SIZE;
+#if defined(_WIN32)
+  if (huge_pages) {
+    // needs SeLockMemoryPrivilege, so quietly fall back if we don't have it
+    size_t large_page = GetLargePageMinimum();
+    if (large_page) {
+      size_t rounded = (alloc_size + large_page - 1) & ~(large_page - 1);
+      start_ptr_ = VirtualAlloc(nullptr, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                                PAGE_READWRITE);
+      virtual_alloc_ = start_ptr_ != nullptr;
+    }
+  }
+  if (!start_ptr_)
+    start_ptr_ = _aligned_malloc(alloc_size, BLOCK_ALIGNMENT);
+  huge_pages_ = virtual_alloc_;
+#else
+  if (posix_memalign(&start_ptr_, huge_pages ? HUGE_PAGE_SIZE : BLOCK_ALIGNMENT, alloc_size))
+    start_ptr_ = nullptr;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  // only a hint, the kernel may or may not actually back it with huge pages
+  if (start_ptr_ && huge_pages)
+    huge_pages_ = madvise(start_ptr_, alloc_size, MADV_HUGEPAGE) == 0;
+#endif
+#endif
+  if (!start_ptr_)
+    return false;
   ALLOC_SIZE_ = alloc_size;
+
+  initBlocks();
+  return true;
+}
+
+bool MemoryManager::reserveMemory(const size_t reserve_size) {
+  if (start_ptr_ || reserve_size == 0)
+    return false;
+
+  // whole pages only, which also keeps the block page (and so cache line)
+  // aligned
+  size_t rounded = (reserve_size + page_size_ - 1) & ~(page_size_ - 1);
+  if (rounded < reserve_size)
+    return false;
+#if defined(_WIN32)
+  start_ptr_ = VirtualAlloc(nullptr, rounded, MEM_RESERVE, PAGE_NOACCESS);
+  virtual_alloc_ = start_ptr_ != nullptr;
+#else
+  // NORESERVE so the reservation doesn't count against overcommit limits
+  // until pages are actually committed
+  start_ptr_ = mmap(nullptr, rounded, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                    -1, 0);
+  if (start_ptr_ == MAP_FAILED)
+    start_ptr_ = nullptr;
+#endif
+  if (!start_ptr_)
+    return false;
+  reserved_ = true;
+  ALLOC_SIZE_ = rounded;
+  initBlocks();
+  return true;
+}
+
+flux_data_ptr MemoryManager::claimSection(size_t size, flux_id &id, size_t alignment,
+                                          memory_tag_t tag) {
+  scoped_timer_t timer(stats_.claim_ns);
+  uint32_t slot = reserveBlock(size, alignment, tag);
+  if (slot != NULL_SLOT && !commitBlock(slot, size)) {
+    freeBlock(slot);
+    slot = NULL_SLOT;
+  }
+  return finishClaim(slot, id, tag);
+}
+
+flux_data_ptr MemoryManager::reserveSection(size_t size, flux_id &id, size_t alignment,
+                                            memory_tag_t tag) {
+  scoped_timer_t timer(stats_.claim_ns);
+  return finishClaim(reserveBlock(size, alignment, tag), id, tag);
+}
+
+bool MemoryManager::commitSection(flux_id id, size_t size) {
+  scoped_timer_t timer(stats_.claim_ns);
+  uint32_t slot = findSlot(id);
+  if (slot == NULL_SLOT)
+    return false;
+  return commitBlock(slot, size);
+}
+
+bool MemoryManager::freeSection(flux_id id) {
+  scoped_timer_t timer(stats_.free_ns);
+  uint32_t slot = findSlot(id);
+  if (slot == NULL_SLOT)
+    return false;
+
+  memory_tag_stats_t &tag = tags_[slots_[slot].tag];
+  tag.claimed -= slots_[slot].size;
+  tag.live_sections--;
+  tag.num_frees++;
+  stats_.num_frees++;
+  relocate_callbacks_[slot] = nullptr;
+  freeBlock(slot);
   return true;
 }
 
-flux_data_ptr MemoryManager::claimSection(size_t size, flux_id &id) {
+memory_tag_t MemoryManager::registerTag(const char *name) {
+  memory_tag_stats_t tag = {};
+  tag.name = name;
+  tags_.push_back(tag);
+  return (memory_tag_t)tags_.size() - 1;
+}
+
+memory_stats_t MemoryManager::getStats() {
+  memory_stats_t stats = stats_;
+  stats.live_sections = num_sections_;
+  stats.claimed = claimed_;
+  stats.committed = committed_;
+  stats.largest_free_block = getLargestFreeBlock();
+  stats.fragmentation = getFragmentation();
+  return stats;
+}
+
+void MemoryManager::recordFrame() {
+  // frames are kept in a ring, the oldest one is overwritten once it's full
+  if (frames_.size() < MAX_RECORDED_FRAMES)
+    frames_.emplace_back();
+  frame_record_t &frame = frames_[num_frames_ % MAX_RECORDED_FRAMES];
+  frame.frame = num_frames_++;
+  frame.stats = getStats();
+  frame.tag_claimed.resize(tags_.size());
+  for (size_t i = 0; i < tags_.size(); i++)
+    frame.tag_claimed[i] = tags_[i].claimed;
+}
+
+void MemoryManager::dumpFrames(FILE *file) {
+  fprintf(file, "frame,live_sections,claimed,committed,largest_free_block,fragmentation,"
+                "claims,failed_claims,frees,slow_searches,claim_us,free_us,defrag_us");
+  for (memory_tag_stats_t &tag : tags_)
+    fprintf(file, ",%s", tag.name.c_str());
+  fprintf(file, "\n");
+
+  // counters and times are totals, so write how much each frame added on top
+  // of the one before it. If older frames were dropped, the oldest one kept
+  // has nothing to compare against and shows up as 0
+  size_t first = (size_t)num_frames_ - frames_.size();
+  memory_stats_t prev = {};
+  for (size_t i = first; i < num_frames_; i++) {
+    frame_record_t &frame = frames_[i % MAX_RECORDED_FRAMES];
+    memory_stats_t &stats = frame.stats;
+    if (i == first && first != 0)
+      prev = stats;
+    fprintf(file, "%llu,%zu,%zu,%zu,%zu,%f,%llu,%llu,%llu,%llu,%.3f,%.3f,%.3f",
+            (unsigned long long)frame.frame, stats.live_sections, stats.claimed,
+            stats.committed, stats.largest_free_block, stats.fragmentation,
+            (unsigned long long)(stats.num_claims - prev.num_claims),
+            (unsigned long long)(stats.num_failed_claims - prev.num_failed_claims),
+            (unsigned long long)(stats.num_frees - prev.num_frees),
+            (unsigned long long)(stats.num_slow_searches - prev.num_slow_searches),
+            (stats.claim_ns - prev.claim_ns) / 1000.0, (stats.free_ns - prev.free_ns) / 1000.0,
+            (stats.defrag_ns - prev.defrag_ns) / 1000.0);
+    // tags registered after a frame was recorded just show up as 0 in it
+    for (size_t tag = 0; tag < tags_.size(); tag++)
+      fprintf(file, ",%zu", tag < frame.tag_claimed.size() ? frame.tag_claimed[tag] : 0);
+    fprintf(file, "\n");
+    prev = stats;
+  }
+}
+
+uint32_t MemoryManager::reserveBlock(size_t size, size_t alignment, memory_tag_t tag) {
   // return false is we cannot claim any more memory
-  if (size == 0 || claimed_ + size > ALLOC_SIZE_ || segments_.size() == MAX_SEGMENTS)
-    return nullptr;
+  if (size == 0 || claimed_ + size > ALLOC_SIZE_)
+    return NULL_SLOT;
+  if (alignment == 0 || (alignment & (alignment - 1)))
+    return NULL_SLOT;
 
-  // see if we can insert this data in a gap
-  size_t offset = 0;
-  for (auto i = segments_.begin(); i != segments_.end(); i++) {
-    if (offset + size <= i->offset) {
-      // increment claimed, insert new memory node
-      claimed_ += size;
-      id = flux_id();
-      memory_node_t node;
-      node.size = size;
-      node.offset = offset;
-      node.id = id;
-      segments_.insert(i, node);
-      return addToPointer(start_ptr_, offset);
-    }
-    offset = i->offset + i->size;
+  uint32_t slot = findFree(size, alignment);
+  if (slot == NULL_SLOT)
+    return NULL_SLOT;
+  removeFree(slot);
+
+  // any padding needed to line up the start stays free, and so does whatever
+  // is left over past the end
+  size_t padding = getPadding(slots_[slot].offset, alignment);
+  if (padding) {
+    uint32_t front = slot;
+    slot = splitBlock(front, padding);
+    insertFree(front);
   }
+  if (slots_[slot].size > size)
+    insertFree(splitBlock(slot, size));
+
+  section_slot_t *block = &slots_[slot];
+  block->alignment = alignment;
+  block->committed = 0;
+  block->tag = tag < tags_.size() ? tag : MEMORY_TAG_UNTAGGED;
+  block->state = SLOT_CLAIMED;
+  claimed_ += size;
+  num_sections_++;
+  return slot;
+}
 
-  // check if we can add it to the back
-  if (offset + size > ALLOC_SIZE_)
+bool MemoryManager::commitBlock(uint32_t slot, size_t size) {
+  section_slot_t &block = slots_[slot];
+  if (size > block.size)
+    return false;
+  if (size <= block.committed)
+    return true;
+  if (reserved_ && !commitPages(block.offset + block.committed, size - block.committed))
+    return false;
+  committed_ += size - block.committed;
+  block.committed = size;
+  return true;
+}
+
+// commits every page touched by [offset, offset + size), pages shared with a
+// neighbouring section may already be committed which is harmless
+bool MemoryManager::commitPages(size_t offset, size_t size) {
+  size_t start = offset & ~(page_size_ - 1);
+  size_t end = (offset + size + page_size_ - 1) & ~(page_size_ - 1);
+#if defined(_WIN32)
+  return VirtualAlloc(addToPointer(start_ptr_, start), end - start, MEM_COMMIT,
+                      PAGE_READWRITE) != nullptr;
+#else
+  return mprotect(addToPointer(start_ptr_, start), end - start, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+// hands out the handle for a freshly claimed slot, and keeps count of claims
+// (including failed ones) for the manager and the tag they were made under
+flux_data_ptr MemoryManager::finishClaim(uint32_t slot, flux_id &id, memory_tag_t tag) {
+  memory_tag_stats_t &tag_stats = tags_[tag < tags_.size() ? tag : MEMORY_TAG_UNTAGGED];
+  if (slot == NULL_SLOT) {
+    stats_.num_failed_claims++;
+    tag_stats.num_failed_claims++;
     return nullptr;
+  }
 
-  // increment claimed and append new memory node
-  claimed_ += size;
-  id = nextId();
-  memory_node_t node;
-  node.size = size;
-  node.offset = offset;
-  node.id = id;
-  segments_.push_back(node);
-  return addToPointer(start_ptr_, offset);
+  stats_.num_claims++;
+  if (claimed_ > stats_.high_water)
+    stats_.high_water = claimed_;
+  tag_stats.num_claims++;
+  tag_stats.live_sections++;
+  tag_stats.claimed += slots_[slot].size;
+  if (tag_stats.claimed > tag_stats.high_water)
+    tag_stats.high_water = tag_stats.claimed;
+  id = makeHandle(slot);
+  return addToPointer(start_ptr_, slots_[slot].offset);
 }
 
-bool MemoryManager::freeSection(flux_id id) {
-  // search through memory segments for correct id
-  for (auto i = segments_.begin(); i != segments_.end(); i++) {
-    if (i->id == id) {
-      // decrement claimed and free that memory segment
-      claimed_ -= i->size;
-      segments_.erase(i);
-      return true;
-    }
+void MemoryManager::freeBlock(uint32_t slot) {
+  claimed_ -= slots_[slot].size;
+  committed_ -= slots_[slot].committed;
+  num_sections_--;
+  // a new generation invalidates every handle to the old section, 0 is
+  // skipped so a handle can never be 0
+  section_slot_t &freed = slots_[slot];
+  freed.generation = (freed.generation + 1) & HANDLE_INDEX_MASK;
+  if (freed.generation == 0)
+    freed.generation = 1;
+
+  // merge with free neighbours, so there are never two free blocks in a row
+  uint32_t next = freed.next;
+  if (next != NULL_SLOT && slots_[next].state == SLOT_FREE) {
+    removeFree(next);
+    slots_[slot].size += slots_[next].size;
+    slots_[slot].next = slots_[next].next;
+    if (slots_[next].next != NULL_SLOT)
+      slots_[slots_[next].next].prev = slot;
+    releaseSlot(next);
+  }
+  uint32_t prev = slots_[slot].prev;
+  if (prev != NULL_SLOT && slots_[prev].state == SLOT_FREE) {
+    removeFree(prev);
+    slots_[prev].size += slots_[slot].size;
+    slots_[prev].next = slots_[slot].next;
+    if (slots_[slot].next != NULL_SLOT)
+      slots_[slots_[slot].next].prev = prev;
+    releaseSlot(slot);
+    slot = prev;
   }
-  return false;
+  insertFree(slot);
 }
 
 flux_data_ptr MemoryManager::getSection(flux_id id) {
-  for (auto i = segments_.begin(); i != segments_.end(); i++) {
-    if (i->id == id) {
-      return addToPointer(start_ptr_, i->offset);
+  uint32_t slot = findSlot(id);
+  if (slot == NULL_SLOT)
+    return nullptr;
+  return addToPointer(start_ptr_, slots_[slot].offset);
+}
+
+bool MemoryManager::setRelocateCallback(flux_id id, relocate_callback_t callback) {
+  uint32_t slot = findSlot(id);
+  if (slot == NULL_SLOT)
+    return false;
+  relocate_callbacks_[slot] = std::move(callback);
+  return true;
+}
+
+void MemoryManager::defrag() { defragStep(SIZE_MAX); }
+
+bool MemoryManager::defragStep(size_t max_bytes, uint64_t max_microseconds) {
+  scoped_timer_t timer(stats_.defrag_ns);
+  auto start_time = std::chrono::steady_clock::now();
+  size_t moved = 0;
+
+  // free blocks never sit next to each other, so every free block but the
+  // last one is followed by a section that can be slid down into it
+  uint32_t gap = first_block_;
+  while (gap != NULL_SLOT) {
+    if (slots_[gap].state != SLOT_FREE) {
+      gap = slots_[gap].next;
+      continue;
     }
+    uint32_t cur = slots_[gap].next;
+    if (cur == NULL_SLOT)
+      break;
+
+    // the gap may be too small to fit cur's alignment padding and still move
+    // it down, so the gap stays put
+    size_t old_offset = slots_[cur].offset;
+    size_t size = slots_[cur].size;
+    size_t committed = slots_[cur].committed;
+    size_t new_offset =
+        slots_[gap].offset + getPadding(slots_[gap].offset, slots_[cur].alignment);
+    if (new_offset >= old_offset) {
+      gap = slots_[cur].next;
+      continue;
+    }
+
+    if (moved && (moved >= max_bytes || committed > max_bytes - moved))
+      return false;
+    if (moved && max_microseconds) {
+      auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start_time);
+      if ((uint64_t)elapsed.count() >= max_microseconds)
+        return false;
+    }
+
+    // only the committed part of a section has anything in it, and the same
+    // amount has to be committed where it's going
+    if (reserved_ && !commitPages(new_offset, committed))
+      return false;
+    memmove(addToPointer(start_ptr_, new_offset), addToPointer(start_ptr_, old_offset),
+            committed);
+    slots_[cur].offset = new_offset;
+    moved += committed;
+
+    // whatever padding cur needs stays free in front of it, and the space it
+    // moved out of joins the block after it
+    removeFree(gap);
+    size_t padding = new_offset - slots_[gap].offset;
+    if (padding) {
+      slots_[gap].size = padding;
+      insertFree(gap);
+    } else {
+      uint32_t prev = slots_[gap].prev;
+      slots_[cur].prev = prev;
+      if (prev == NULL_SLOT)
+        first_block_ = cur;
+      else
+        slots_[prev].next = cur;
+      releaseSlot(gap);
+    }
+    size_t shift = old_offset - new_offset;
+    uint32_t next = slots_[cur].next;
+    if (next != NULL_SLOT && slots_[next].state == SLOT_FREE) {
+      removeFree(next);
+      slots_[next].offset -= shift;
+      slots_[next].size += shift;
+      insertFree(next);
+      gap = next;
+    } else {
+      slots_[cur].size += shift;
+      gap = splitBlock(cur, size);
+      insertFree(gap);
+    }
+
+    if (relocate_callbacks_[cur])
+      relocate_callbacks_[cur](addToPointer(start_ptr_, new_offset));
+  }
+  return true;
+}
+
+// everything starts out as one big free block
+void MemoryManager::initBlocks() {
+  first_block_ = allocSlot();
+  slots_[first_block_].size = ALLOC_SIZE_;
+  slots_[first_block_].offset = 0;
+  slots_[first_block_].alignment = 1;
+  slots_[first_block_].prev = NULL_SLOT;
+  slots_[first_block_].next = NULL_SLOT;
+  insertFree(first_block_);
+}
+
+// cuts slot down to size, and gives the rest of it to a new block right after
+// it. The new block isn't put in any free list
+uint32_t MemoryManager::splitBlock(uint32_t slot, size_t size) {
+  uint32_t rest = allocSlot();
+  section_slot_t &block = slots_[slot];
+  section_slot_t &rest_block = slots_[rest];
+  rest_block.size = block.size - size;
+  rest_block.offset = block.offset + size;
+  rest_block.alignment = 1;
+  rest_block.prev = slot;
+  rest_block.next = block.next;
+  if (block.next != NULL_SLOT)
+    slots_[block.next].prev = rest;
+  block.next = rest;
+  block.size = size;
+  return rest;
+}
+
+size_t MemoryManager::getLargestFreeBlock() {
+  if (!fl_bitmap_)
+    return 0;
+  // the biggest block has to be in the highest non empty size class, but
+  // blocks in a class aren't sorted
+  int fl = bits::highestBit(fl_bitmap_);
+  int sl = bits::highestBit(sl_bitmaps_[fl]);
+  size_t largest = 0;
+  for (uint32_t cur = free_lists_[fl][sl]; cur != NULL_SLOT; cur = slots_[cur].free_next) {
+    if (slots_[cur].size > largest)
+      largest = slots_[cur].size;
+  }
+  return largest;
+}
+
+float MemoryManager::getFragmentation() {
+  size_t amount_free = ALLOC_SIZE_ - claimed_;
+  if (amount_free == 0)
+    return 0.0f;
+  return 1.0f - (float)getLargestFreeBlock() / (float)amount_free;
+}
+
+uint32_t MemoryManager::allocSlot() {
+  uint32_t slot;
+  if (unused_slots_ != NULL_SLOT) {
+    slot = unused_slots_;
+    unused_slots_ = slots_[slot].free_next;
+  } else {
+    if (slots_.size() >= HANDLE_INDEX_MASK)
+      throw std::runtime_error("MemoryManager ran out of section handles");
+    slot = (uint32_t)slots_.size();
+    slots_.push_back(section_slot_t());
+    relocate_callbacks_.push_back(nullptr);
+    slots_[slot].generation = 1;
   }
-  return nullptr;
+  slots_[slot].state = SLOT_FREE;
+  return slot;
+}
+
+void MemoryManager::releaseSlot(uint32_t slot) {
+  slots_[slot].state = SLOT_UNUSED;
+  slots_[slot].free_next = unused_slots_;
+  unused_slots_ = slot;
 }
 
-void MemoryManager::defrag() {
-  size_t sorted_offset = 0;
-  for (auto i = segments_.begin(); i != segments_.end(); i++) {
-    // we have found a freed gap in memory, so we sift everything back
-    if (i->offset != sorted_offset) {
-      memmove(addToPointer(start_ptr_, sorted_offset),
-              addToPointer(start_ptr_, i->offset) , i->size);
-      i->offset = sorted_offset;
+// sizes under SL_COUNT each get their own class, past that each power of two
+// is split into SL_COUNT evenly sized classes
+void MemoryManager::mapping(size_t size, int &fl, int &sl) {
+  if (size < (size_t)SL_COUNT) {
+    fl = 0;
+    sl = (int)size;
+    return;
+  }
+  int log2 = bits::highestBit(size);
+  fl = log2 - SL_BITS + 1;
+  sl = (int)((size >> (log2 - SL_BITS)) ^ SL_COUNT);
+}
+
+void MemoryManager::insertFree(uint32_t slot) {
+  int fl, sl;
+  mapping(slots_[slot].size, fl, sl);
+  uint32_t head = free_lists_[fl][sl];
+  slots_[slot].state = SLOT_FREE;
+  slots_[slot].free_prev = NULL_SLOT;
+  slots_[slot].free_next = head;
+  if (head != NULL_SLOT)
+    slots_[head].free_prev = slot;
+  free_lists_[fl][sl] = slot;
+  fl_bitmap_ |= (uint64_t)1 << fl;
+  sl_bitmaps_[fl] |= 1u << sl;
+  num_free_blocks_++;
+}
+
+void MemoryManager::removeFree(uint32_t slot) {
+  int fl, sl;
+  mapping(slots_[slot].size, fl, sl);
+  uint32_t prev = slots_[slot].free_prev;
+  uint32_t next = slots_[slot].free_next;
+  if (prev != NULL_SLOT)
+    slots_[prev].free_next = next;
+  else
+    free_lists_[fl][sl] = next;
+  if (next != NULL_SLOT)
+    slots_[next].free_prev = prev;
+
+  if (free_lists_[fl][sl] == NULL_SLOT) {
+    sl_bitmaps_[fl] &= ~(1u << sl);
+    if (!sl_bitmaps_[fl])
+      fl_bitmap_ &= ~((uint64_t)1 << fl);
+  }
+  num_free_blocks_--;
+}
+
+uint32_t MemoryManager::findFree(size_t size, size_t alignment) {
+  // worst case we need alignment - 1 bytes of padding, round that up to the
+  // next class boundary so that any block in the class we land on is big
+  // enough no matter where it starts
+  size_t needed = size + alignment - 1;
+  if (needed < size)
+    return NULL_SLOT;
+  size_t rounded = needed;
+  if (needed >= (size_t)SL_COUNT) {
+    size_t step = (size_t)1 << (bits::highestBit(needed) - SL_BITS);
+    if (rounded + step - 1 > rounded)
+      rounded += step - 1;
+  }
+  int fl, sl;
+  mapping(rounded, fl, sl);
+
+  uint32_t sl_map = sl_bitmaps_[fl] & (~0u << sl);
+  if (!sl_map) {
+    uint64_t fl_map = fl + 1 < FL_COUNT ? fl_bitmap_ & (~(uint64_t)0 << (fl + 1)) : 0;
+    if (fl_map) {
+      fl = bits::lowestBit(fl_map);
+      sl_map = sl_bitmaps_[fl];
     }
-    sorted_offset += i->size;
+  }
+  if (sl_map)
+    return free_lists_[fl][bits::lowestBit(sl_map)];
+
+  // nothing in a class that is sure to fit, but a block in one of the few
+  // classes between size and rounded might still fit once we know how much
+  // padding it actually needs (e.g. an exactly sized block that is already
+  // aligned). Only look at a handful of them so claims stay constant time
+  if (rounded == size)
+    return NULL_SLOT;
+  stats_.num_slow_searches++;
+  int min_fl, min_sl, max_fl, max_sl;
+  mapping(size, min_fl, min_sl);
+  mapping(rounded, max_fl, max_sl);
+  int remaining = SLOW_SEARCH_LIMIT;
+  for (fl = min_fl; fl <= max_fl; fl++) {
+    uint32_t classes = sl_bitmaps_[fl] & (fl == min_fl ? ~0u << min_sl : ~0u);
+    if (fl == max_fl)
+      classes &= (1u << max_sl) - 1;
+    for (; classes; classes &= classes - 1) {
+      for (uint32_t cur = free_lists_[fl][bits::lowestBit(classes)]; cur != NULL_SLOT;
+           cur = slots_[cur].free_next) {
+        section_slot_t &block = slots_[cur];
+        if (block.size >= size + getPadding(block.offset, alignment))
+          return cur;
+        if (--remaining == 0)
+          return NULL_SLOT;
+      }
+    }
+  }
+  return NULL_SLOT;
+}
+
+void MemoryManager::resetFreeLists() {
+  fl_bitmap_ = 0;
+  num_free_blocks_ = 0;
+  for (int fl = 0; fl < FL_COUNT; fl++) {
+    sl_bitmaps_[fl] = 0;
+    for (int sl = 0; sl < SL_COUNT; sl++)
+      free_lists_[fl][sl] = NULL_SLOT;
   }
 }
 
-} // namespace flux
\ No newline at end of file
+} // namespace flux
@@ -1,6 +1,10 @@
 #ifndef MEMORY_MANAGER_H
 #define MEMORY_MANAGER_H
 
+#include <functional>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
 #include <vector>
 
 namespace flux {
@@ -8,39 +12,209 @@ namespace flux {
 typedef size_t flux_id;
 // TODO(wraftus) should probably be some type of smart pointer
 typedef void *flux_data_ptr;
+// called with a section's new address whenever a defrag moves it
+typedef std::function<void(flux_data_ptr)> relocate_callback_t;
 
+// sections can be tagged with whatever they're used for, so stats can be
+// broken down by who is using the memory. Every manager starts with just the
+// untagged tag
+typedef uint32_t memory_tag_t;
+constexpr memory_tag_t MEMORY_TAG_UNTAGGED = 0;
+
+struct memory_stats_t {
+  size_t live_sections;
+  size_t claimed;
+  size_t high_water; // most that has ever been claimed at once
+  size_t committed;
+  size_t largest_free_block;
+  float fragmentation;
+  uint64_t num_claims;
+  uint64_t num_failed_claims;
+  uint64_t num_frees;
+  // claims that missed the size class bitmaps and had to walk free blocks
+  uint64_t num_slow_searches;
+  // time spent claiming (and committing), freeing and defragging
+  uint64_t claim_ns;
+  uint64_t free_ns;
+  uint64_t defrag_ns;
+};
+
+struct memory_tag_stats_t {
+  std::string name;
+  size_t live_sections;
+  size_t claimed;
+  size_t high_water;
+  uint64_t num_claims;
+  uint64_t num_failed_claims;
+  uint64_t num_frees;
+};
+
+// sections are addressed by a handle packing a slot index in the low half of
+// the flux_id and that slot's generation in the high half. Freeing a section
+// bumps its slot's generation, so stale handles are caught instead of
+// aliasing whatever claims the slot next. 0 is never a valid handle.
+//
+// Free space is tracked TLSF style: free blocks are bucketed into size classes
+// by a two level bitmap (power of two, then 16 linear steps within it), so a
+// claim is a couple of bit scans and a free merges with its neighbours in
+// constant time
 class MemoryManager {
 public:
   MemoryManager();
   ~MemoryManager();
 
   
-  bool allocMemory(const size_t alloc_size);
+  // the block always starts on a cache line. With huge_pages set, large
+  // blocks are asked to be backed by huge pages (transparent huge pages on
+  // linux, large pages on windows if the process is allowed them), which cuts
+  // down on TLB misses when walking big arrays
+  bool allocMemory(const size_t alloc_size, bool huge_pages = false);
+  // instead of allocating a block up front, only reserves reserve_size bytes
+  // of address space. Pages are committed as sections ask for them, so the
+  // reservation can be sized for the worst case while memory use follows what
+  // is actually claimed
+  bool reserveMemory(const size_t reserve_size);
 
-  flux_data_ptr claimSection(size_t size, flux_id &id);
+  // alignment has to be a power of two, and is applied to the actual address
+  flux_data_ptr claimSection(size_t size, flux_id &id, size_t alignment = 1,
+                             memory_tag_t tag = MEMORY_TAG_UNTAGGED);
+  // claims the address space for a section without committing any of it, the
+  // section can't be touched past what commitSection has committed. In a block
+  // from allocMemory everything is always committed
+  flux_data_ptr reserveSection(size_t size, flux_id &id, size_t alignment = 1,
+                               memory_tag_t tag = MEMORY_TAG_UNTAGGED);
+  // makes sure the first size bytes of the section are backed by memory, the
+  // section never moves so pointers into it stay good
+  bool commitSection(flux_id id, size_t size);
   bool freeSection(flux_id id);
   flux_data_ptr getSection(flux_id id);
+  inline bool isValid(flux_id id) { return findSlot(id) != NULL_SLOT; }
+  // anyone holding a raw pointer to a section should register a callback, so
+  // they get the new address when a defrag moves it. Callbacks must not claim
+  // or free sections. Freeing the section drops its callback
+  bool setRelocateCallback(flux_id id, relocate_callback_t callback);
   
+  // slides every section down to the start of the block (keeping each one's
+  // alignment), leaving one free block at the end
   void defrag();
+  // the same compaction spread over several calls, each moving sections until
+  // it has moved max_bytes or run for max_microseconds (0 for no limit). At
+  // least one section is moved per call, so a section bigger than max_bytes
+  // still gets moved eventually. Returns true once there is nothing left to
+  // move
+  bool defragStep(size_t max_bytes, uint64_t max_microseconds = 0);
 
   inline size_t getAmountClaimed() { return claimed_; }
   inline size_t getMaxSize() { return ALLOC_SIZE_; }
+  inline size_t getAmountCommitted() { return committed_; }
+  inline bool isReserved() { return reserved_; }
+  inline bool usesHugePages() { return huge_pages_; }
+  inline size_t getNumSections() { return num_sections_; }
+  inline size_t getNumFreeBlocks() { return num_free_blocks_; }
+  size_t getLargestFreeBlock();
+  // 0 when all free memory is in one block, approaching 1 as it gets split up
+  float getFragmentation();
+
+  // claims with an unknown tag count as untagged
+  memory_tag_t registerTag(const char *name);
+  inline size_t getNumTags() { return tags_.size(); }
+  inline const memory_tag_stats_t &getTagStats(memory_tag_t tag) { return tags_[tag]; }
+  memory_stats_t getStats();
+  // snapshots the stats, meant to be called once a frame. Only the last
+  // MAX_RECORDED_FRAMES are kept
+  void recordFrame();
+  // writes the recorded frames out as csv, one row per frame with how much
+  // each frame claimed, freed and spent, and how much each tag has claimed
+  void dumpFrames(FILE *file);
 
 protected:
+  static constexpr uint32_t NULL_SLOT = 0xFFFFFFFF;
+  static constexpr size_t HANDLE_INDEX_BITS = sizeof(flux_id) * 4;
+  static constexpr flux_id HANDLE_INDEX_MASK = ((flux_id)1 << HANDLE_INDEX_BITS) - 1;
+  static constexpr int SL_BITS = 4;
+  static constexpr int SL_COUNT = 1 << SL_BITS;
+  static constexpr int FL_COUNT = sizeof(size_t) * 8;
+  static constexpr size_t MAX_RECORDED_FRAMES = 600;
+  // most free blocks findFree will look at one by one before giving up
+  static constexpr int SLOW_SEARCH_LIMIT = 8;
+
   size_t ALLOC_SIZE_;
   size_t claimed_;
+  size_t committed_;
+  size_t num_sections_;
+  size_t num_free_blocks_;
   flux_data_ptr start_ptr_;
-  flux_id cur_id_;
+  bool huge_pages_;
+  bool virtual_alloc_;
+  bool reserved_;
+  size_t page_size_;
 
-  struct memory_node_t {
+  enum slot_state_t : uint8_t { SLOT_UNUSED, SLOT_FREE, SLOT_CLAIMED };
+  // every block of memory, claimed or free, gets a slot. Blocks are linked to
+  // their neighbours in memory through prev/next, and free ones are also
+  // linked into their size class through free_prev/free_next. Unused slots are
+  // linked through free_next
+  struct section_slot_t {
     size_t size;
     size_t offset;
-    flux_id id;
+    size_t alignment;
+    size_t committed; // how much of a claimed section is backed by memory
+    flux_id generation;
+    memory_tag_t tag;
+    uint32_t prev;
+    uint32_t next;
+    uint32_t free_prev;
+    uint32_t free_next;
+    slot_state_t state;
   };
-  std::vector<memory_node_t> segments_;
+  std::vector<section_slot_t> slots_;
+  std::vector<relocate_callback_t> relocate_callbacks_; // one per slot
+  uint32_t first_block_;
+  uint32_t unused_slots_;
 
-  inline flux_id nextId() { 
-    return cur_id_++;
+  struct frame_record_t {
+    uint64_t frame;
+    memory_stats_t stats;
+    std::vector<size_t> tag_claimed;
+  };
+  memory_stats_t stats_;
+  std::vector<memory_tag_stats_t> tags_;
+  std::vector<frame_record_t> frames_;
+  uint64_t num_frames_;
+
+  uint64_t fl_bitmap_;
+  uint32_t sl_bitmaps_[FL_COUNT];
+  uint32_t free_lists_[FL_COUNT][SL_COUNT];
+
+  uint32_t reserveBlock(size_t size, size_t alignment, memory_tag_t tag);
+  bool commitBlock(uint32_t slot, size_t size);
+  flux_data_ptr finishClaim(uint32_t slot, flux_id &id, memory_tag_t tag);
+  void freeBlock(uint32_t slot);
+  uint32_t allocSlot();
+  void releaseSlot(uint32_t slot);
+  void insertFree(uint32_t slot);
+  void removeFree(uint32_t slot);
+  uint32_t findFree(size_t size, size_t alignment);
+  uint32_t splitBlock(uint32_t slot, size_t size);
+  void initBlocks();
+  void resetFreeLists();
+  bool commitPages(size_t offset, size_t size);
+
+  static void mapping(size_t size, int &fl, int &sl);
+
+  inline flux_id makeHandle(uint32_t slot) {
+    return (slots_[slot].generation << HANDLE_INDEX_BITS) | slot;
+  }
+  inline uint32_t findSlot(flux_id id) {
+    flux_id slot = id & HANDLE_INDEX_MASK;
+    if (slot >= slots_.size() || slots_[slot].state != SLOT_CLAIMED ||
+        slots_[slot].generation != (id >> HANDLE_INDEX_BITS))
+      return NULL_SLOT;
+    return (uint32_t)slot;
+  }
+  inline size_t getPadding(size_t offset, size_t alignment) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(start_ptr_) + offset;
+    return (size_t)((alignment - (address & (alignment - 1))) & (alignment - 1));
   }
   // TODO (wraftus) this is kinda nasty
   inline static flux_data_ptr addToPointer(flux_data_ptr ptr, size_t incr) {
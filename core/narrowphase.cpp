@@ -0,0 +1,276 @@
+#include "narrowphase.h"
+
+#include <stdexcept>
+
+#if FLUX_X86
+#include <immintrin.h>
+#endif
+
+// NOTE every path has to do the same multiplies, adds, and min/max chains in
+// the same order to give bit identical results, so a * b + c can't be
+// contracted into an fma. flux.vcxproj keeps this file on /fp:precise, gcc and
+// clang builds have to compile it with -ffp-contract=off, since they contract
+// with -mfma or -march=native otherwise
+
+namespace flux {
+
+// ----- Scalar Path -----
+// same semantics as minps/maxps, including which side wins on NaN
+inline static float minLane(float a, float b) { return a < b ? a : b; }
+inline static float maxLane(float a, float b) { return a > b ? a : b; }
+
+// true if the corners projected onto (axis_x, axis_y) miss [axis_min, axis_max]
+inline static bool separatedScalar(float axis_x, float axis_y, float axis_min,
+                                   float axis_max, const float *corners) {
+  float proj1 = axis_x * corners[0] + axis_y * corners[1];
+  float proj2 = axis_x * corners[2] + axis_y * corners[3];
+  float proj3 = axis_x * corners[4] + axis_y * corners[5];
+  float proj4 = axis_x * corners[6] + axis_y * corners[7];
+  float min = minLane(minLane(minLane(proj1, proj2), proj3), proj4);
+  float max = maxLane(maxLane(maxLane(proj1, proj2), proj3), proj4);
+  return max < axis_min || axis_max < min;
+}
+
+static void satTestScalar(const sat_streams_t &outer_rects, uint32_t outer,
+                          const sat_streams_t &candidate_rects,
+                          const uint32_t *candidates, size_t num_candidates,
+                          uint8_t *hits) {
+  const float *const *o = outer_rects.stream;
+  const float *const *c = candidate_rects.stream;
+  float outer_corners[8];
+  for (int i = 0; i < 8; i++)
+    outer_corners[i] = o[SAT_V1_X + i][outer];
+
+  for (size_t i = 0; i < num_candidates; i++) {
+    uint32_t inner = candidates[i];
+    float inner_corners[8];
+    for (int j = 0; j < 8; j++)
+      inner_corners[j] = c[SAT_V1_X + j][inner];
+
+    bool separated =
+        separatedScalar(o[SAT_AXIS1_X][outer], o[SAT_AXIS1_Y][outer],
+                        o[SAT_MIN1][outer], o[SAT_MAX1][outer], inner_corners) ||
+        separatedScalar(o[SAT_AXIS2_X][outer], o[SAT_AXIS2_Y][outer],
+                        o[SAT_MIN2][outer], o[SAT_MAX2][outer], inner_corners) ||
+        separatedScalar(c[SAT_AXIS1_X][inner], c[SAT_AXIS1_Y][inner],
+                        c[SAT_MIN1][inner], c[SAT_MAX1][inner], outer_corners) ||
+        separatedScalar(c[SAT_AXIS2_X][inner], c[SAT_AXIS2_Y][inner],
+                        c[SAT_MIN2][inner], c[SAT_MAX2][inner], outer_corners);
+    hits[i] = !separated;
+  }
+}
+// -----------------------
+
+#if FLUX_X86
+// ----- SSE2 Path -----
+FLUX_TARGET_SSE2
+inline static __m128 separatedSSE(__m128 axis_x, __m128 axis_y, __m128 axis_min,
+                                  __m128 axis_max, const __m128 *corners) {
+  __m128 proj1 = _mm_add_ps(_mm_mul_ps(axis_x, corners[0]), _mm_mul_ps(axis_y, corners[1]));
+  __m128 proj2 = _mm_add_ps(_mm_mul_ps(axis_x, corners[2]), _mm_mul_ps(axis_y, corners[3]));
+  __m128 proj3 = _mm_add_ps(_mm_mul_ps(axis_x, corners[4]), _mm_mul_ps(axis_y, corners[5]));
+  __m128 proj4 = _mm_add_ps(_mm_mul_ps(axis_x, corners[6]), _mm_mul_ps(axis_y, corners[7]));
+  __m128 min = _mm_min_ps(_mm_min_ps(_mm_min_ps(proj1, proj2), proj3), proj4);
+  __m128 max = _mm_max_ps(_mm_max_ps(_mm_max_ps(proj1, proj2), proj3), proj4);
+  return _mm_or_ps(_mm_cmplt_ps(max, axis_min), _mm_cmplt_ps(axis_max, min));
+}
+
+FLUX_TARGET_SSE2
+static void satTestSSE2(const sat_streams_t &outer_rects, uint32_t outer,
+                        const sat_streams_t &candidate_rects,
+                        const uint32_t *candidates, size_t num_candidates,
+                        uint8_t *hits) {
+  const float *const *o = outer_rects.stream;
+  const float *const *c = candidate_rects.stream;
+  __m128 outer_lanes[SAT_NUM_STREAMS];
+  for (int i = 0; i < SAT_NUM_STREAMS; i++)
+    outer_lanes[i] = _mm_set1_ps(o[i][outer]);
+
+  size_t i = 0;
+  for (; i + 4 <= num_candidates; i += 4) {
+    // SSE2 has no gather, so load the four candidates lane by lane
+    const uint32_t *idx = candidates + i;
+    __m128 inner_lanes[SAT_NUM_STREAMS];
+    for (int j = 0; j < SAT_NUM_STREAMS; j++)
+      inner_lanes[j] = _mm_setr_ps(c[j][idx[0]], c[j][idx[1]], c[j][idx[2]], c[j][idx[3]]);
+
+    __m128 separated = _mm_or_ps(
+        _mm_or_ps(separatedSSE(outer_lanes[SAT_AXIS1_X], outer_lanes[SAT_AXIS1_Y],
+                               outer_lanes[SAT_MIN1], outer_lanes[SAT_MAX1],
+                               inner_lanes + SAT_V1_X),
+                  separatedSSE(outer_lanes[SAT_AXIS2_X], outer_lanes[SAT_AXIS2_Y],
+                               outer_lanes[SAT_MIN2], outer_lanes[SAT_MAX2],
+                               inner_lanes + SAT_V1_X)),
+        _mm_or_ps(separatedSSE(inner_lanes[SAT_AXIS1_X], inner_lanes[SAT_AXIS1_Y],
+                               inner_lanes[SAT_MIN1], inner_lanes[SAT_MAX1],
+                               outer_lanes + SAT_V1_X),
+                  separatedSSE(inner_lanes[SAT_AXIS2_X], inner_lanes[SAT_AXIS2_Y],
+                               inner_lanes[SAT_MIN2], inner_lanes[SAT_MAX2],
+                               outer_lanes + SAT_V1_X)));
+
+    int mask = _mm_movemask_ps(separated);
+    for (int j = 0; j < 4; j++)
+      hits[i + j] = !((mask >> j) & 1);
+  }
+
+  // leftovers that don't fill a whole register
+  satTestScalar(outer_rects, outer, candidate_rects, candidates + i,
+                num_candidates - i, hits + i);
+}
+// ---------------------
+
+// ----- AVX2 Path -----
+FLUX_TARGET_AVX2
+inline static __m256 separatedAVX2(__m256 axis_x, __m256 axis_y, __m256 axis_min,
+                                   __m256 axis_max, const __m256 *corners) {
+  __m256 proj1 = _mm256_add_ps(_mm256_mul_ps(axis_x, corners[0]),
+                               _mm256_mul_ps(axis_y, corners[1]));
+  __m256 proj2 = _mm256_add_ps(_mm256_mul_ps(axis_x, corners[2]),
+                               _mm256_mul_ps(axis_y, corners[3]));
+  __m256 proj3 = _mm256_add_ps(_mm256_mul_ps(axis_x, corners[4]),
+                               _mm256_mul_ps(axis_y, corners[5]));
+  __m256 proj4 = _mm256_add_ps(_mm256_mul_ps(axis_x, corners[6]),
+                               _mm256_mul_ps(axis_y, corners[7]));
+  __m256 min = _mm256_min_ps(_mm256_min_ps(_mm256_min_ps(proj1, proj2), proj3), proj4);
+  __m256 max = _mm256_max_ps(_mm256_max_ps(_mm256_max_ps(proj1, proj2), proj3), proj4);
+  return _mm256_or_ps(_mm256_cmp_ps(max, axis_min, _CMP_LT_OQ),
+                      _mm256_cmp_ps(axis_max, min, _CMP_LT_OQ));
+}
+
+FLUX_TARGET_AVX2
+static void satTestAVX2(const sat_streams_t &outer_rects, uint32_t outer,
+                        const sat_streams_t &candidate_rects,
+                        const uint32_t *candidates, size_t num_candidates,
+                        uint8_t *hits) {
+  const float *const *o = outer_rects.stream;
+  const float *const *c = candidate_rects.stream;
+  __m256 outer_lanes[SAT_NUM_STREAMS];
+  for (int i = 0; i < SAT_NUM_STREAMS; i++)
+    outer_lanes[i] = _mm256_set1_ps(o[i][outer]);
+
+  size_t i = 0;
+  for (; i + 8 <= num_candidates; i += 8) {
+    __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(candidates + i));
+    __m256 inner_lanes[SAT_NUM_STREAMS];
+    for (int j = 0; j < SAT_NUM_STREAMS; j++)
+      inner_lanes[j] = _mm256_i32gather_ps(c[j], idx, sizeof(float));
+
+    __m256 separated = _mm256_or_ps(
+        _mm256_or_ps(separatedAVX2(outer_lanes[SAT_AXIS1_X], outer_lanes[SAT_AXIS1_Y],
+                                   outer_lanes[SAT_MIN1], outer_lanes[SAT_MAX1],
+                                   inner_lanes + SAT_V1_X),
+                     separatedAVX2(outer_lanes[SAT_AXIS2_X], outer_lanes[SAT_AXIS2_Y],
+                                   outer_lanes[SAT_MIN2], outer_lanes[SAT_MAX2],
+                                   inner_lanes + SAT_V1_X)),
+        _mm256_or_ps(separatedAVX2(inner_lanes[SAT_AXIS1_X], inner_lanes[SAT_AXIS1_Y],
+                                   inner_lanes[SAT_MIN1], inner_lanes[SAT_MAX1],
+                                   outer_lanes + SAT_V1_X),
+                     separatedAVX2(inner_lanes[SAT_AXIS2_X], inner_lanes[SAT_AXIS2_Y],
+                                   inner_lanes[SAT_MIN2], inner_lanes[SAT_MAX2],
+                                   outer_lanes + SAT_V1_X)));
+
+    int mask = _mm256_movemask_ps(separated);
+    for (int j = 0; j < 8; j++)
+      hits[i + j] = !((mask >> j) & 1);
+  }
+
+  // leftovers that don't fill a whole register
+  satTestScalar(outer_rects, outer, candidate_rects, candidates + i,
+                num_candidates - i, hits + i);
+}
+// ---------------------
+#endif
+
+void satPenetration(const sat_streams_t &rects, uint32_t outer, uint32_t inner,
+                    Vector2D &axis, float &depth) {
+  satPenetration(rects, outer, rects, inner, axis, depth);
+}
+
+void satPenetration(const sat_streams_t &outer_rects, uint32_t outer,
+                    const sat_streams_t &inner_rects, uint32_t inner, Vector2D &axis,
+                    float &depth) {
+  const float *const *streams[2] = {outer_rects.stream, inner_rects.stream};
+  uint32_t idxs[2] = {outer, inner};
+  Vector2D centers[2];
+  for (int i = 0; i < 2; i++) {
+    const float *const *s = streams[i];
+    for (int j = 0; j < 4; j++)
+      centers[i] += Vector2D(s[SAT_V1_X + 2 * j][idxs[i]], s[SAT_V1_Y + 2 * j][idxs[i]]);
+    centers[i] /= 4.0f;
+  }
+
+  // try all four axes and keep the one with the smallest overlap
+  depth = INFINITY;
+  for (int i = 0; i < 2; i++) {
+    const float *const *s = streams[i];
+    const float *const *other_s = streams[1 - i];
+    uint32_t own = idxs[i];
+    uint32_t other = idxs[1 - i];
+    for (int j = 0; j < 2; j++) {
+      Vector2D cur_axis(s[SAT_AXIS1_X + 2 * j][own], s[SAT_AXIS1_Y + 2 * j][own]);
+      float own_min = s[SAT_MIN1 + 2 * j][own];
+      float own_max = s[SAT_MAX1 + 2 * j][own];
+
+      float other_min = INFINITY, other_max = -INFINITY;
+      for (int k = 0; k < 4; k++) {
+        float proj = vector::dot(cur_axis, Vector2D(other_s[SAT_V1_X + 2 * k][other],
+                                                    other_s[SAT_V1_Y + 2 * k][other]));
+        other_min = minLane(other_min, proj);
+        other_max = maxLane(other_max, proj);
+      }
+
+      float overlap = minLane(own_max, other_max) - maxLane(own_min, other_min);
+      if (overlap < depth) {
+        depth = overlap;
+        axis = cur_axis;
+      }
+    }
+  }
+
+  // flip the axis so it points from outer to inner
+  if (vector::dot(axis, centers[1] - centers[0]) < 0.0f)
+    axis = -axis;
+}
+
+void satTest(const sat_streams_t &rects, uint32_t outer, const uint32_t *candidates,
+             size_t num_candidates, uint8_t *hits) {
+  satTest(rects, outer, rects, candidates, num_candidates, hits);
+}
+
+void satTest(const sat_streams_t &outer_rects, uint32_t outer,
+             const sat_streams_t &candidate_rects, const uint32_t *candidates,
+             size_t num_candidates, uint8_t *hits) {
+  // pick the widest path once, nothing here benefits from AVX-512 over AVX2
+  static simd_level_t level =
+      cpu::getSimdLevel() > SIMD_AVX2 ? SIMD_AVX2 : cpu::getSimdLevel();
+  satTest(level, outer_rects, outer, candidate_rects, candidates, num_candidates, hits);
+}
+
+void satTest(simd_level_t level, const sat_streams_t &rects, uint32_t outer,
+             const uint32_t *candidates, size_t num_candidates, uint8_t *hits) {
+  satTest(level, rects, outer, rects, candidates, num_candidates, hits);
+}
+
+void satTest(simd_level_t level, const sat_streams_t &outer_rects, uint32_t outer,
+             const sat_streams_t &candidate_rects, const uint32_t *candidates,
+             size_t num_candidates, uint8_t *hits) {
+  if (level > cpu::getSimdLevel())
+    throw std::invalid_argument("satTest called with an unsupported SIMD level");
+
+  switch (level) {
+#if FLUX_X86
+  case SIMD_AVX512:
+  case SIMD_AVX2:
+    satTestAVX2(outer_rects, outer, candidate_rects, candidates, num_candidates, hits);
+    break;
+  case SIMD_SSE2:
+    satTestSSE2(outer_rects, outer, candidate_rects, candidates, num_candidates, hits);
+    break;
+#endif
+  default:
+    satTestScalar(outer_rects, outer, candidate_rects, candidates, num_candidates, hits);
+    break;
+  }
+}
+
+} // namespace flux
\ No newline at end of file
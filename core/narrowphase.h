@@ -0,0 +1,58 @@
+#ifndef NARROWPHASE_H
+#define NARROWPHASE_H
+
+#include "cpu_features.h"
+#include "../data_structres/vectors.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace flux {
+
+// every value the SAT test needs from a rectangle, with each one stored in its
+// own stream so a batch of rectangles can be loaded straight into SIMD lanes
+enum sat_stream_t {
+  SAT_V1_X, SAT_V1_Y, // world space corners, same order as rectangle_t
+  SAT_V2_X, SAT_V2_Y,
+  SAT_V3_X, SAT_V3_Y,
+  SAT_V4_X, SAT_V4_Y,
+  SAT_AXIS1_X, SAT_AXIS1_Y, // unit normal to the "top" face
+  SAT_AXIS2_X, SAT_AXIS2_Y, // unit normal to the "right" face
+  SAT_MIN1, SAT_MAX1, // rectangles own projection onto axis1
+  SAT_MIN2, SAT_MAX2, // rectangles own projection onto axis2
+  SAT_NUM_STREAMS
+};
+
+struct sat_streams_t {
+  const float *stream[SAT_NUM_STREAMS];
+};
+
+// tests rectangle outer against every rectangle in candidates, setting
+// hits[i] to 1 if candidates[i] overlaps it and 0 otherwise. Runs 8 (AVX2) or
+// 4 (SSE2) candidates at a time depending on the cpu, every path does the
+// exact same float operations so results never depend on the machine
+void satTest(const sat_streams_t &rects, uint32_t outer, const uint32_t *candidates,
+             size_t num_candidates, uint8_t *hits);
+// same as above but forced down a specific path, level must be supported
+void satTest(simd_level_t level, const sat_streams_t &rects, uint32_t outer,
+             const uint32_t *candidates, size_t num_candidates, uint8_t *hits);
+// same as above but with the candidates coming from a different set of
+// streams than outer, e.g. a rectangle against static level geometry
+void satTest(const sat_streams_t &outer_rects, uint32_t outer,
+             const sat_streams_t &candidate_rects, const uint32_t *candidates,
+             size_t num_candidates, uint8_t *hits);
+void satTest(simd_level_t level, const sat_streams_t &outer_rects, uint32_t outer,
+             const sat_streams_t &candidate_rects, const uint32_t *candidates,
+             size_t num_candidates, uint8_t *hits);
+
+// finds the axis of least penetration between two overlapping rectangles,
+// axis is a unit vector pointing from outer towards inner
+void satPenetration(const sat_streams_t &rects, uint32_t outer, uint32_t inner,
+                    Vector2D &axis, float &depth);
+void satPenetration(const sat_streams_t &outer_rects, uint32_t outer,
+                    const sat_streams_t &inner_rects, uint32_t inner, Vector2D &axis,
+                    float &depth);
+
+} // namespace flux
+
+#endif // NARROWPHASE_H
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "tilemap_collider.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace flux {
+
+TilemapCollider::TilemapCollider(uint32_t width, uint32_t height, float tile_size,
+                                 Vector2D origin)
+    : width_(width), height_(height), tile_size_(tile_size), origin_(origin),
+      tiles_(width * height, 0), merged_(false) {
+  if (!(tile_size > 0.0f))
+    throw std::invalid_argument("TilemapCollider tile size must be positive");
+  inv_tile_size_ = 1.0f / tile_size;
+  for (int i = 0; i < SAT_NUM_STREAMS; i++)
+    sat_streams_.stream[i] = nullptr;
+}
+
+void TilemapCollider::setSolid(uint32_t x, uint32_t y, bool solid) {
+  if (x >= width_ || y >= height_)
+    return;
+  tiles_[y * width_ + x] = solid;
+  merged_ = false;
+}
+
+void TilemapCollider::mergeSolidTiles() {
+  tile_box_.assign(width_ * height_, NO_BOX);
+  tile_rects_.clear();
+  for (uint32_t y = 0; y < height_; y++) {
+    for (uint32_t x = 0; x < width_; x++) {
+      if (!isFree(x, y))
+        continue;
+
+      // take the whole run to the right, then grow it up row by row
+      uint32_t run = 1;
+      while (x + run < width_ && isFree(x + run, y))
+        run++;
+      uint32_t rows = 1;
+      for (; y + rows < height_; rows++) {
+        bool row_free = true;
+        for (uint32_t i = 0; i < run && row_free; i++)
+          row_free = isFree(x + i, y + rows);
+        if (!row_free)
+          break;
+      }
+
+      uint32_t box = (uint32_t)tile_rects_.size();
+      for (uint32_t j = 0; j < rows; j++) {
+        for (uint32_t i = 0; i < run; i++)
+          tile_box_[(y + j) * width_ + x + i] = box;
+      }
+      tile_rects_.push_back(tile_rect_t{(int32_t)x, (int32_t)y, (int32_t)run, (int32_t)rows});
+    }
+  }
+
+  // world space bounds and SAT streams, every box is axis aligned so its
+  // axes are the same as an unrotated rectangle's
+  size_t num_boxes = tile_rects_.size();
+  boxes_.resize(num_boxes);
+  for (auto &stream : box_sat_)
+    stream.resize(num_boxes);
+  for (size_t i = 0; i < num_boxes; i++) {
+    tile_rect_t &rect = tile_rects_[i];
+    Vector2D min = origin_ + Vector2D(rect.x * tile_size_, rect.y * tile_size_);
+    Vector2D max = origin_ + Vector2D((rect.x + rect.width) * tile_size_,
+                                      (rect.y + rect.height) * tile_size_);
+    boxes_[i] = aabb_t(min, max);
+
+    Vector2D corners[4] = {max, Vector2D(min.x, max.y), min, Vector2D(max.x, min.y)};
+    for (int j = 0; j < 4; j++) {
+      box_sat_[SAT_V1_X + 2 * j][i] = corners[j].x;
+      box_sat_[SAT_V1_Y + 2 * j][i] = corners[j].y;
+    }
+    box_sat_[SAT_AXIS1_X][i] = 0.0f;
+    box_sat_[SAT_AXIS1_Y][i] = 1.0f;
+    box_sat_[SAT_AXIS2_X][i] = 1.0f;
+    box_sat_[SAT_AXIS2_Y][i] = 0.0f;
+    box_sat_[SAT_MIN1][i] = min.y;
+    box_sat_[SAT_MAX1][i] = max.y;
+    box_sat_[SAT_MIN2][i] = min.x;
+    box_sat_[SAT_MAX2][i] = max.x;
+  }
+  for (int i = 0; i < SAT_NUM_STREAMS; i++)
+    sat_streams_.stream[i] = box_sat_[i].data();
+  merged_ = true;
+}
+
+void TilemapCollider::findBoxes(const aabb_t &bounds, std::vector<uint32_t> &boxes) {
+  if (!merged_ || width_ == 0 || height_ == 0)
+    return;
+
+  int32_t min_x = std::max(toMinTile(bounds.min.x, origin_.x), 0);
+  int32_t min_y = std::max(toMinTile(bounds.min.y, origin_.y), 0);
+  int32_t max_x = std::min(toMaxTile(bounds.max.x, origin_.x), (int32_t)width_ - 1);
+  int32_t max_y = std::min(toMaxTile(bounds.max.y, origin_.y), (int32_t)height_ - 1);
+  for (int32_t y = min_y; y <= max_y; y++) {
+    for (int32_t x = min_x; x <= max_x; x++) {
+      uint32_t box = tile_box_[y * width_ + x];
+      if (box == NO_BOX)
+        continue;
+      // a box covers a block of tiles, so only report it from the first one
+      // of them we walk over
+      tile_rect_t &rect = tile_rects_[box];
+      if (x != std::max(rect.x, min_x) || y != std::max(rect.y, min_y))
+        continue;
+      boxes.push_back(box);
+    }
+  }
+}
+
+} // namespace flux
@@ -0,0 +1,92 @@
+#ifndef TILEMAP_COLLIDER_H
+#define TILEMAP_COLLIDER_H
+
+#include "narrowphase.h"
+#include "../data_structres/aabb.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace flux {
+
+// grid of solid and empty square tiles, with tile (0, 0) having its min
+// corner at origin. Solid tiles are merged into a handful of large boxes
+// rather than being collided with one at a time, which also keeps colliders
+// sliding along a wall from catching on the seams between tiles
+class TilemapCollider {
+public:
+  static constexpr uint32_t NO_BOX = 0xFFFFFFFF;
+
+  TilemapCollider(uint32_t width, uint32_t height, float tile_size,
+                  Vector2D origin = Vector2D());
+
+  inline uint32_t getWidth() { return width_; }
+  inline uint32_t getHeight() { return height_; }
+  inline float getTileSize() { return tile_size_; }
+  inline Vector2D getOrigin() { return origin_; }
+
+  // anything outside of the grid counts as empty
+  inline bool isSolid(int32_t x, int32_t y) {
+    if (x < 0 || y < 0 || (uint32_t)x >= width_ || (uint32_t)y >= height_)
+      return false;
+    return tiles_[y * width_ + x] != 0;
+  }
+  // changing any tile throws away the merged boxes until the next merge
+  void setSolid(uint32_t x, uint32_t y, bool solid);
+
+  // greedily merges solid tiles into boxes, each box is a horizontal run of
+  // tiles grown upwards for as long as the rows above have the same run.
+  // Meant to be done once when a level is generated, not every frame
+  void mergeSolidTiles();
+  inline bool isMerged() { return merged_; }
+
+  // world space merged boxes, along with their SAT streams for the narrowphase
+  inline size_t getNumBoxes() { return boxes_.size(); }
+  inline const aabb_t *getBoxes() { return boxes_.data(); }
+  inline const sat_streams_t &getSatStreams() { return sat_streams_; }
+  inline uint32_t getTileBox(uint32_t x, uint32_t y) { return tile_box_[y * width_ + x]; }
+
+  // appends the index of every merged box covering a tile that bounds
+  // overlaps, each only once. Only walks the tiles under bounds
+  void findBoxes(const aabb_t &bounds, std::vector<uint32_t> &boxes);
+
+private:
+  // a merged box in tile coordinates
+  struct tile_rect_t {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+  };
+
+  uint32_t width_;
+  uint32_t height_;
+  float tile_size_;
+  float inv_tile_size_;
+  Vector2D origin_;
+  std::vector<uint8_t> tiles_;
+
+  bool merged_;
+  std::vector<uint32_t> tile_box_;
+  std::vector<tile_rect_t> tile_rects_;
+  std::vector<aabb_t> boxes_;
+  std::vector<float> box_sat_[SAT_NUM_STREAMS];
+  sat_streams_t sat_streams_;
+
+  // touching counts as overlapping, so bounds starting exactly on a tile edge
+  // also take in the tile before it
+  inline int32_t toMinTile(float pos, float origin) {
+    return (int32_t)ceilf((pos - origin) * inv_tile_size_) - 1;
+  }
+  inline int32_t toMaxTile(float pos, float origin) {
+    return (int32_t)floorf((pos - origin) * inv_tile_size_);
+  }
+  inline bool isFree(uint32_t x, uint32_t y) {
+    uint32_t idx = y * width_ + x;
+    return tiles_[idx] && tile_box_[idx] == NO_BOX;
+  }
+};
+
+} // namespace flux
+
+#endif // TILEMAP_COLLIDER_H
\ No newline at end of file
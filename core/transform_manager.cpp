@@ -0,0 +1,236 @@
+#include "transform_manager.h"
+#include "batch_math.h"
+#include "../data_structres/handle_map.h"
+
+#include <stdexcept>
+
+namespace flux {
+
+TransformManager::TransformManager(size_t num_components, FrameArena *frame_arena,
+                                   EntityRegistry *registry)
+    : order_dirty_(false), frame_arena_(frame_arena), registry_(registry) {
+  size_t alloc_size = decltype(transforms_)::claimSize(num_components) +
+                      ComponentArray<flux_id>::claimSize(num_components) +
+                      ComponentArray<Affine2D>::claimSize(num_components);
+  // only reserved, so num_components can be sized for the worst case and
+  // memory is only committed as transforms are attached
+  if (!memory_manager_.reserveMemory(alloc_size) ||
+      !entity_ids_.reserveMemory(&memory_manager_, num_components) ||
+      !transforms_.reserveMemory(&memory_manager_, num_components) ||
+      !world_.reserveMemory(&memory_manager_, num_components))
+    throw std::runtime_error("Failed to reserve transform memory");
+  if (registry_)
+    registry_->onRemove<transform_t>([this](flux_id entity) {
+      uint32_t idx = find(entity);
+      if (idx != SparseSet::INVALID_IDX)
+        removeTransform(idx);
+    });
+}
+
+TransformManager::~TransformManager() {
+  if (registry_)
+    registry_->onRemove<transform_t>(nullptr);
+}
+
+bool TransformManager::attachToEntity(flux_id entity_id, const Vector2D &trans, float rot,
+                                      flux_id parent_id) {
+  // the index could also still be held by a stale entity
+  if (entities_idx_.contains(HandleMap::getIndex(entity_id)))
+    return false;
+  uint32_t parent_idx = SparseSet::INVALID_IDX;
+  if (parent_id) {
+    parent_idx = find(parent_id);
+    if (parent_idx == SparseSet::INVALID_IDX)
+      return false;
+  }
+
+  if (!entity_ids_.emplace(entity_id))
+    return false;
+  if (!transforms_.emplace(trans, rot, parent_idx)) {
+    entity_ids_.removeSwap(entity_ids_.size() - 1);
+    return false;
+  }
+  // the world transform in the registry is filled in by the next updateWorld
+  if (!world_.emplace(Affine2D()) ||
+      (registry_ && !registry_->emplace(entity_id, transform_t()))) {
+    truncateAll(entity_ids_.size() - 1, entity_ids_, transforms_, world_);
+    return false;
+  }
+  entities_idx_.insert(HandleMap::getIndex(entity_id));
+  order_dirty_ = true;
+  return true;
+}
+
+bool TransformManager::detachFromEntity(flux_id entity_id) {
+  uint32_t idx = find(entity_id);
+  if (idx == SparseSet::INVALID_IDX)
+    return false;
+  // the registry calls back into removeTransform
+  if (registry_)
+    return registry_->remove<transform_t>(entity_id);
+  removeTransform(idx);
+  return true;
+}
+
+void TransformManager::removeTransform(uint32_t idx) {
+  // the last transform is about to be moved into idx, so anything parented
+  // to it has to follow
+  uint32_t last = (uint32_t)size() - 1;
+  uint32_t *parent_buff = getParents();
+  for (uint32_t i = 0; i < size(); i++) {
+    if (parent_buff[i] == idx)
+      transforms_.modify<transform_parent_field_t>(i) = SparseSet::INVALID_IDX;
+    else if (parent_buff[i] == last)
+      parent_buff[i] = idx;
+  }
+  entities_idx_.remove(HandleMap::getIndex(entity_ids_.buffer_[idx]));
+  entity_ids_.removeSwap(idx);
+  transforms_.removeSwap(idx);
+  world_.removeSwap(idx);
+  order_dirty_ = true;
+}
+
+bool TransformManager::setParent(flux_id entity_id, flux_id parent_id) {
+  uint32_t idx = find(entity_id);
+  if (idx == SparseSet::INVALID_IDX)
+    return false;
+  uint32_t parent_idx = SparseSet::INVALID_IDX;
+  if (parent_id) {
+    parent_idx = find(parent_id);
+    if (parent_idx == SparseSet::INVALID_IDX)
+      return false;
+    // would make a cycle
+    uint32_t *parent_buff = getParents();
+    for (uint32_t up = parent_idx; up != SparseSet::INVALID_IDX; up = parent_buff[up]) {
+      if (up == idx)
+        return false;
+    }
+  }
+
+  transforms_.modify<transform_parent_field_t>(idx) = parent_idx;
+  order_dirty_ = true;
+  return true;
+}
+
+uint32_t TransformManager::find(flux_id entity_id) {
+  uint32_t idx = entities_idx_.find(HandleMap::getIndex(entity_id));
+  if (idx == SparseSet::INVALID_IDX || entity_ids_.buffer_[idx] != entity_id)
+    return SparseSet::INVALID_IDX;
+  return idx;
+}
+
+void TransformManager::updateWorld() {
+  if (order_dirty_)
+    sortByDepth();
+
+  size_t num_transforms = size();
+  // sin and cos are taken as one block, so the arena is never left holding
+  // one of them when the other doesn't fit
+  float *sin_rot = frame_arena_ ? frame_arena_->tryAlloc<float>(num_transforms * 2) : nullptr;
+  float *cos_rot;
+  if (sin_rot) {
+    cos_rot = sin_rot + num_transforms;
+  } else {
+    heap_sin_rot_.resize(num_transforms);
+    heap_cos_rot_.resize(num_transforms);
+    sin_rot = heap_sin_rot_.data();
+    cos_rot = heap_cos_rot_.data();
+  }
+  batch::sinCos(getRotations(), num_transforms, sin_rot, cos_rot);
+
+  // parents always come first, so whether one changed this update is known
+  // by the time its children are reached
+  Vector2D *trans_buff = getTranslations();
+  uint32_t *parent_buff = getParents();
+  Affine2D *world_buff = world_.buffer_;
+  dirty_scratch_.assign(num_transforms, false);
+  for (size_t i = 0; i < num_transforms; i++) {
+    uint32_t parent = parent_buff[i];
+    bool parent_changed = parent != SparseSet::INVALID_IDX && dirty_scratch_[parent];
+    if (!parent_changed && !transforms_.isDirty(i))
+      continue;
+
+    Affine2D local = Affine2D::fromRotation(cos_rot[i], sin_rot[i], trans_buff[i]);
+    world_.modify(i) = parent == SparseSet::INVALID_IDX ? local : world_buff[parent] * local;
+    dirty_scratch_[i] = true;
+    if (registry_)
+      *registry_->modify<transform_t>(entity_ids_.buffer_[i]) = getTransform(i);
+  }
+  transforms_.clearDirty();
+}
+
+template <class T> void TransformManager::reorder(T *buffer) {
+  std::vector<T> old_buffer(buffer, buffer + size());
+  for (size_t i = 0; i < old_buffer.size(); i++)
+    buffer[i] = old_buffer[old_idxs_[i]];
+}
+
+void TransformManager::sortByDepth() {
+  uint32_t num_transforms = (uint32_t)size();
+  uint32_t *parent_buff = getParents();
+
+  // walk up from each transform until reaching one whose depth is known or
+  // a root, then fill in everything passed on the way
+  depths_.assign(num_transforms, SparseSet::INVALID_IDX);
+  level_starts_.assign(1, 0);
+  for (uint32_t i = 0; i < num_transforms; i++) {
+    uint32_t top = i, steps = 0;
+    while (depths_[top] == SparseSet::INVALID_IDX &&
+           parent_buff[top] != SparseSet::INVALID_IDX) {
+      top = parent_buff[top];
+      steps++;
+    }
+    uint32_t depth = (depths_[top] == SparseSet::INVALID_IDX ? 0 : depths_[top]) + steps;
+    for (uint32_t down = i;
+         down != SparseSet::INVALID_IDX && depths_[down] == SparseSet::INVALID_IDX;
+         down = parent_buff[down])
+      depths_[down] = depth--;
+    if (depths_[i] + 2 > level_starts_.size())
+      level_starts_.resize(depths_[i] + 2, 0);
+    level_starts_[depths_[i] + 1]++;
+  }
+
+  // counting sort, which keeps transforms in the same order within a level
+  for (size_t level = 1; level < level_starts_.size(); level++)
+    level_starts_[level] += level_starts_[level - 1];
+  new_idxs_.resize(num_transforms);
+  old_idxs_.resize(num_transforms);
+  for (uint32_t i = 0; i < num_transforms; i++) {
+    new_idxs_[i] = level_starts_[depths_[i]]++;
+    old_idxs_[new_idxs_[i]] = i;
+  }
+
+  reorder(entity_ids_.buffer_);
+  reorder(getTranslations());
+  reorder(getRotations());
+  reorder(parent_buff);
+  reorder(world_.buffer_);
+  for (uint32_t i = 0; i < num_transforms; i++) {
+    if (parent_buff[i] != SparseSet::INVALID_IDX)
+      parent_buff[i] = new_idxs_[parent_buff[i]];
+  }
+
+  // dirty bits have to move with their transforms
+  dirty_scratch_.resize(num_transforms);
+  for (uint32_t i = 0; i < num_transforms; i++)
+    dirty_scratch_[new_idxs_[i]] = transforms_.isDirty(i);
+  transforms_.clearDirty();
+  for (uint32_t i = 0; i < num_transforms; i++) {
+    if (dirty_scratch_[i])
+      transforms_.markDirty(i);
+  }
+  for (uint32_t i = 0; i < num_transforms; i++)
+    dirty_scratch_[new_idxs_[i]] = world_.isDirty(i);
+  world_.clearDirty();
+  for (uint32_t i = 0; i < num_transforms; i++) {
+    if (dirty_scratch_[i])
+      world_.markDirty(i);
+  }
+
+  entities_idx_.clear();
+  for (uint32_t i = 0; i < num_transforms; i++)
+    entities_idx_.insert(HandleMap::getIndex(entity_ids_.buffer_[i]));
+  order_dirty_ = false;
+}
+
+}
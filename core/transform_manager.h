@@ -3,8 +3,14 @@
 
 #include "../data_structres/vectors.h"
 #include "../data_structres/component_array.h"
+#include "../data_structres/soa_component_array.h"
+#include "../data_structres/sparse_set.h"
+#include "entity_registry.h"
+#include "frame_arena.h"
 #include "memory_manager.h"
 
+#include <vector>
+
 namespace flux {
 
 struct transform_t {
@@ -15,36 +21,111 @@ struct transform_t {
   float cos_rot;
 };
 
+// TransformManager's streams. Parents are indices into the same streams
+struct transform_trans_field_t { typedef Vector2D type; };
+struct transform_rot_field_t { typedef float type; };
+struct transform_parent_field_t { typedef uint32_t type; };
+
+// keeps a single angle per transform instead of its sin and cos, and works
+// out the sin and cos of every transform at once in updateWorld, which is far
+// cheaper than calling sinf and cosf for each one that changed. The sin and
+// cos come out of frame_arena if there is one.
+//
+// Transforms can be parented to another entity's transform, in which case
+// their translation and rotation are relative to it. The streams are kept
+// sorted by depth in the hierarchy, so every parent comes before its
+// children and world transforms are worked out in one pass from front to
+// back. Attaching, detaching and reparenting only flag the order as stale,
+// it's sorted again in the next updateWorld, which moves transforms to new
+// indices.
+//
+// With a registry, every transform also gets a transform_t component in it
+// that updateWorld keeps at the world transform, which is what other systems
+// read. Removing that component, or destroying the entity, detaches the
+// transform here too
 class TransformManager {
 public:
-  TransformManager(size_t num_components) {
-    size_t alloc_size = num_components * (sizeof(transform_t) + sizeof(flux_id));
-    memory_manager_.allocMemory(alloc_size);
-    transforms_.claimMemory(&memory_manager_, num_components);
-  }
+  TransformManager(size_t num_components, FrameArena *frame_arena = nullptr,
+                   EntityRegistry *registry = nullptr);
+  ~TransformManager();
 
-  bool attachToEntity(flux_id entity_id, Vector2D &trans, float rot) {
-    transform_t transform;
-    transform.trans = trans;
-    transform.sin_rot = cosf(rot);
-    transform.cos_rot = sinf(rot);
-    bool success = transforms_.emplace(transform) 
-                && entity_ids_.emplace(entity_id);
-  }
+  // trans and rot are relative to parent_id's transform, or the world if it's
+  // 0. Fails if entity_id already has a transform or parent_id doesn't, or if
+  // entity_id isn't alive in the registry
+  bool attachToEntity(flux_id entity_id, const Vector2D &trans, float rot,
+                      flux_id parent_id = 0);
+  // children of the removed transform become roots, keeping their local
+  // transform as their world one
+  bool detachFromEntity(flux_id entity_id);
+  // parent_id of 0 makes entity_id a root. Fails if parent_id is entity_id
+  // or one of its descendants
+  bool setParent(flux_id entity_id, flux_id parent_id);
+
+  // SparseSet::INVALID_IDX if entity_id doesn't have a transform
+  uint32_t find(flux_id entity_id);
+  inline size_t size() { return entity_ids_.size(); }
+  inline flux_id *getIdBuffer() { return entity_ids_.buffer_; }
+  // local translations and rotations
+  inline Vector2D *getTranslations() { return transforms_.data<transform_trans_field_t>(); }
+  // in radians, and best kept within a few thousand of 0, see batch::sinCos
+  inline float *getRotations() { return transforms_.data<transform_rot_field_t>(); }
+  // SparseSet::INVALID_IDX for roots
+  inline uint32_t *getParents() { return transforms_.data<transform_parent_field_t>(); }
 
-  inline size_t* getIdBuffer() {
-    return entity_ids_.buffer_; 
+  // same as writing through the buffers above, but marks the transform dirty
+  // so it and everything under it are recomputed by updateWorld
+  inline Vector2D &modifyTranslation(size_t idx) {
+    return transforms_.modify<transform_trans_field_t>(idx);
   }
-  inline transform_t* getTransforms() {
-    return transforms_.buffer_;
+  inline float &modifyRotation(size_t idx) {
+    return transforms_.modify<transform_rot_field_t>(idx);
   }
 
+  // sorts the streams if the hierarchy changed, then recomputes the world
+  // transform of everything that was modified, along with everything under it
+  void updateWorld();
+  // world transforms as of the last updateWorld. They're only ever rotations
+  // and translations, so the x axis is the cos and sin of the world rotation
+  inline Affine2D *getWorldBuffer() { return world_.buffer_; }
+  inline transform_t getTransform(size_t idx) {
+    transform_t transform;
+    transform.trans = world_.buffer_[idx].trans;
+    transform.sin_rot = world_.buffer_[idx].x_axis.y;
+    transform.cos_rot = world_.buffer_[idx].x_axis.x;
+    return transform;
+  }
+  // transforms whose world transform changed since the last clearDirty
+  template <class F> inline void forEachDirty(F func) { world_.forEachDirty(func); }
+  inline void clearDirty() { world_.clearDirty(); }
+
 private:
   MemoryManager memory_manager_;
   ComponentArray<flux_id> entity_ids_;
-  ComponentArray<transform_t> transforms_;
+  SoAComponentArray<transform_trans_field_t, transform_rot_field_t, transform_parent_field_t>
+      transforms_;
+  ComponentArray<Affine2D> world_;
+  // keyed by entity index
+  SparseSet entities_idx_;
+  bool order_dirty_;
+
+  FrameArena *frame_arena_;
+  EntityRegistry *registry_;
+  // only used without a frame arena, or if it runs out of room
+  std::vector<float> heap_sin_rot_;
+  std::vector<float> heap_cos_rot_;
+
+  // scratch for sorting
+  std::vector<uint32_t> depths_;
+  std::vector<uint32_t> level_starts_;
+  std::vector<uint32_t> new_idxs_;
+  std::vector<uint32_t> old_idxs_;
+  std::vector<bool> dirty_scratch_;
+
+  void removeTransform(uint32_t idx);
+  void sortByDepth();
+  template <class T> void reorder(T *buffer);
 };
 
 }
 
-#endif // TRANSFORM_MANAGER_H23
\ No newline at end of file
+#endif // TRANSFORM_MANAGER_H
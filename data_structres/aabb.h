@@ -0,0 +1,83 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include "vectors.h"
+
+namespace flux {
+
+// ----- Axis Aligned Bounding Box -----
+struct aabb_t {
+  aabb_t() {}
+  aabb_t(Vector2D min, Vector2D max) : min(min), max(max) {}
+  Vector2D min;
+  Vector2D max;
+};
+// -------------------------------------
+
+// --- Bounding Box Math Functions -----
+namespace aabb {
+
+// touching boxes count as overlapping, same as the SAT narrowphase
+inline bool overlaps(const aabb_t &a, const aabb_t &b) {
+  return a.min.x <= b.max.x && b.min.x <= a.max.x &&
+         a.min.y <= b.max.y && b.min.y <= a.max.y;
+}
+inline bool contains(const aabb_t &outer, const aabb_t &inner) {
+  return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y &&
+         inner.max.x <= outer.max.x && inner.max.y <= outer.max.y;
+}
+inline bool contains(const aabb_t &box, const Vector2D &point) {
+  return box.min.x <= point.x && point.x <= box.max.x &&
+         box.min.y <= point.y && point.y <= box.max.y;
+}
+inline aabb_t merge(const aabb_t &a, const aabb_t &b) {
+  return aabb_t(Vector2D(fminf(a.min.x, b.min.x), fminf(a.min.y, b.min.y)),
+                Vector2D(fmaxf(a.max.x, b.max.x), fmaxf(a.max.y, b.max.y)));
+}
+inline aabb_t fatten(const aabb_t &box, float margin) {
+  return aabb_t(box.min - Vector2D(margin, margin), box.max + Vector2D(margin, margin));
+}
+inline float perimeter(const aabb_t &box) {
+  return 2.0f * ((box.max.x - box.min.x) + (box.max.y - box.min.y));
+}
+// 0 if the point is inside the box
+inline float distanceSquared(const aabb_t &box, const Vector2D &point) {
+  float dx = fmaxf(fmaxf(box.min.x - point.x, point.x - box.max.x), 0.0f);
+  float dy = fmaxf(fmaxf(box.min.y - point.y, point.y - box.max.y), 0.0f);
+  return dx * dx + dy * dy;
+}
+
+// slab test for the ray origin + t * dir with t in [0, max_t], t is set to
+// where the ray enters the box (0 if it starts inside)
+inline bool raycast(const aabb_t &box, const Vector2D &origin, const Vector2D &dir,
+                    float max_t, float &t) {
+  float t_min = 0.0f, t_max = max_t;
+  const float box_min[2] = {box.min.x, box.min.y};
+  const float box_max[2] = {box.max.x, box.max.y};
+  const float ray_origin[2] = {origin.x, origin.y};
+  const float ray_dir[2] = {dir.x, dir.y};
+  for (int i = 0; i < 2; i++) {
+    if (ray_dir[i] == 0.0f) {
+      // parallel to this slab, so it has to start inside it
+      if (ray_origin[i] < box_min[i] || ray_origin[i] > box_max[i])
+        return false;
+      continue;
+    }
+    float inv_dir = 1.0f / ray_dir[i];
+    float t1 = (box_min[i] - ray_origin[i]) * inv_dir;
+    float t2 = (box_max[i] - ray_origin[i]) * inv_dir;
+    t_min = fmaxf(t_min, fminf(t1, t2));
+    t_max = fminf(t_max, fmaxf(t1, t2));
+    if (t_min > t_max)
+      return false;
+  }
+  t = t_min;
+  return true;
+}
+
+}
+// -------------------------------------
+
+} // namespace flux
+
+#endif // AABB_H
\ No newline at end of file
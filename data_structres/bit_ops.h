@@ -0,0 +1,51 @@
+#ifndef BIT_OPS_H
+#define BIT_OPS_H
+
+#include <stdint.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace flux {
+
+// --------- Bit Scan Functions --------
+namespace bits {
+
+// index of the lowest/highest set bit, x must not be 0
+inline int lowestBit(uint64_t x) {
+#if defined(_MSC_VER) && defined(_WIN64)
+  unsigned long idx;
+  _BitScanForward64(&idx, x);
+  return (int)idx;
+#elif defined(_MSC_VER)
+  unsigned long idx;
+  if (_BitScanForward(&idx, (unsigned long)x))
+    return (int)idx;
+  _BitScanForward(&idx, (unsigned long)(x >> 32));
+  return (int)idx + 32;
+#else
+  return __builtin_ctzll(x);
+#endif
+}
+inline int highestBit(uint64_t x) {
+#if defined(_MSC_VER) && defined(_WIN64)
+  unsigned long idx;
+  _BitScanReverse64(&idx, x);
+  return (int)idx;
+#elif defined(_MSC_VER)
+  unsigned long idx;
+  if (_BitScanReverse(&idx, (unsigned long)(x >> 32)))
+    return (int)idx + 32;
+  _BitScanReverse(&idx, (unsigned long)x);
+  return (int)idx;
+#else
+  return 63 - __builtin_clzll(x);
+#endif
+}
+
+}
+// -------------------------------------
+
+} // namespace flux
+
+#endif // BIT_OPS_H
@@ -2,11 +2,16 @@
 #define COMPONENT_ARRAY_H
 
 #include "../core/memory_manager.h"
+#include "dirty_bitset.h"
 
 #include <stdexcept>
 
 namespace flux {
 
+// arrays start on their own cache line by default, so no two arrays ever
+// share one and every array is ready for aligned SIMD loads
+constexpr size_t COMPONENT_ALIGNMENT = 64;
+
 // TODO(wraftus) make the class sit in the same memory location as the data
 template <class T> class ComponentArray {
 public:
@@ -15,6 +20,7 @@ public:
   ComponentArray() {
     buffer_ = nullptr;
     num_components_ = 0;
+    capacity_ = 0;
     MAX_COMPONENTS = 0;
     memory_manager_ = nullptr;
     buffer_id_ = 0;
@@ -23,34 +29,103 @@ public:
     if (buffer_)
       memory_manager_->freeSection(buffer_id_);
   }
+  // the memory manager holds on to this to fix up buffer_ after a defrag, so
+  // arrays can't be copied around
+  ComponentArray(const ComponentArray &) = delete;
+  ComponentArray &operator=(const ComponentArray &) = delete;
+
+  // how much space claimMemory could need, padding included, for sizing
+  // the MemoryManager up front
+  inline static size_t claimSize(size_t max_components,
+                                 size_t alignment = COMPONENT_ALIGNMENT) {
+    return sizeof(T) * max_components + alignment - 1;
+  }
 
-  // TODO(wraftus) make sure that the array is aligned on a cahce line
-  inline bool claimMemory(MemoryManager *memory_manager, size_t max_components) {
+  inline bool claimMemory(MemoryManager *memory_manager, size_t max_components,
+                          size_t alignment = COMPONENT_ALIGNMENT,
+                          memory_tag_t tag = MEMORY_TAG_UNTAGGED) {
     // should only claim memory once, and shouldn't create an empty array
     if (buffer_ || max_components == 0)
       return false;
 
     // try to claim the memory we need
     flux_data_ptr ptr =
-        memory_manager->claimSection(sizeof(T) * max_components, buffer_id_);
+        memory_manager->claimSection(sizeof(T) * max_components, buffer_id_, alignment, tag);
     if (!ptr)
       return false;
 
     MAX_COMPONENTS = max_components;
+    capacity_ = max_components;
     memory_manager_ = memory_manager;
     buffer_ = static_cast<T *>(ptr);
+    memory_manager->setRelocateCallback(
+        buffer_id_, [this](flux_data_ptr new_ptr) { buffer_ = static_cast<T *>(new_ptr); });
+    return true;
+  }
+  // like claimMemory, but only room for initial_components is committed up
+  // front and the array grows in place as it fills, up to max_components.
+  // With a manager from reserveMemory nothing past what's committed is backed
+  // by memory, so max_components can be sized for the worst case
+  inline bool reserveMemory(MemoryManager *memory_manager, size_t max_components,
+                            size_t initial_components = 0,
+                            size_t alignment = COMPONENT_ALIGNMENT,
+                            memory_tag_t tag = MEMORY_TAG_UNTAGGED) {
+    if (buffer_ || max_components == 0 || initial_components > max_components)
+      return false;
+
+    flux_data_ptr ptr =
+        memory_manager->reserveSection(sizeof(T) * max_components, buffer_id_, alignment, tag);
+    if (!ptr)
+      return false;
+
+    MAX_COMPONENTS = max_components;
+    memory_manager_ = memory_manager;
+    buffer_ = static_cast<T *>(ptr);
+    memory_manager->setRelocateCallback(
+        buffer_id_, [this](flux_data_ptr new_ptr) { buffer_ = static_cast<T *>(new_ptr); });
+    return initial_components == 0 || reserve(initial_components);
+  }
+  // hands the buffer back to the memory manager, after which the array can
+  // claim or reserve memory again
+  inline void releaseMemory() {
+    if (!buffer_)
+      return;
+    memory_manager_->freeSection(buffer_id_);
+    buffer_ = nullptr;
+    num_components_ = 0;
+    capacity_ = 0;
+    MAX_COMPONENTS = 0;
+    memory_manager_ = nullptr;
+    buffer_id_ = 0;
+    dirty_.clear();
+  }
+  // makes sure there is room for num_components without growing again
+  inline bool reserve(size_t num_components) {
+    if (!buffer_ || num_components > MAX_COMPONENTS)
+      return false;
+    if (num_components <= capacity_)
+      return true;
+    if (!memory_manager_->commitSection(buffer_id_, sizeof(T) * num_components))
+      return false;
+    capacity_ = num_components;
     return true;
   }
   inline size_t size() { return num_components_; }
+  inline size_t capacity() { return capacity_; }
+  inline size_t maxSize() { return MAX_COMPONENTS; }
 
+  // every slot whose component is added, moved or changed through modify is
+  // marked dirty until the next clearDirty. Writes straight to buffer_ aren't
+  // tracked
   inline bool emplace(const T &component) {
-    if (!buffer_ || num_components_ == MAX_COMPONENTS)
+    if (!buffer_ || (num_components_ == capacity_ && !grow()))
       return false;
+    dirty_.set(num_components_);
     buffer_[num_components_++] = component;
     return true;
   }
   inline bool insert(size_t idx, const T &component){
-    if (!buffer_ || num_components_ == MAX_COMPONENTS || idx > num_components_)
+    if (!buffer_ || idx > num_components_ || (num_components_ == capacity_ && !grow()))
       return false;
     if (idx < num_components_) {
       for (size_t i = num_components_; i > idx; i--) {
@@ -59,6 +134,8 @@ public:
     }
     num_components_++;
     buffer_[idx] = component;
+    for (size_t i = idx; i < num_components_; i++)
+      dirty_.set(i);
     return true;
   }
   inline bool remove(size_t idx) {
@@ -66,19 +143,89 @@ public:
       return false;
     for (size_t i = idx; i + 1 < num_components_; i++) {
       buffer_[i] = buffer_[i + 1];
+      dirty_.set(i);
     }
-    num_components_--;
+    dirty_.reset(--num_components_);
+    return true;
+  }
+  // O(1) remove that moves the last component into the hole instead of
+  // shifting everything after it down, so it doesn't keep the order
+  inline bool removeSwap(size_t idx) {
+    if (!buffer_ || idx >= num_components_)
+      return false;
+    buffer_[idx] = buffer_[--num_components_];
+    if (idx < num_components_)
+      dirty_.set(idx);
+    dirty_.reset(num_components_);
     return true;
   }
 
+  // mutable access that marks the component dirty
+  inline T &modify(size_t idx) {
+    dirty_.set(idx);
+    return buffer_[idx];
+  }
+  inline void markDirty(size_t idx) { dirty_.set(idx); }
+  inline bool isDirty(size_t idx) { return dirty_.test(idx); }
+  inline void clearDirty() { dirty_.clear(); }
+  // calls func(idx) for each dirty component in [begin, end), in order
+  template <class F> inline void forEachDirty(size_t begin, size_t end, F func) {
+    dirty_.forEach(begin, std::min(end, num_components_), func);
+  }
+  template <class F> inline void forEachDirty(F func) {
+    dirty_.forEach(0, num_components_, func);
+  }
+
 private:
   size_t num_components_;
+  size_t capacity_;
   size_t MAX_COMPONENTS;
 
   MemoryManager *memory_manager_;
   flux_id buffer_id_;
+  DirtyBitset dirty_;
+
+  // doubles the committed room, the buffer stays where it is
+  inline bool grow() {
+    if (capacity_ == MAX_COMPONENTS)
+      return false;
+    size_t new_capacity = capacity_ ? capacity_ * 2 : MIN_GROWTH;
+    return reserve(new_capacity < MAX_COMPONENTS ? new_capacity : MAX_COMPONENTS);
+  }
+  static constexpr size_t MIN_GROWTH = 64 / sizeof(T) ? 64 / sizeof(T) : 1;
 };
 
+// swap removes idx from every array passed in, arrays of ComponentArrays
+// included, so arrays kept in parallel stay lined up
+template <class Array> inline void removeSwapAll(size_t idx, Array &array) {
+  array.removeSwap(idx);
+}
+template <class Array, size_t N> inline void removeSwapAll(size_t idx, Array (&arrays)[N]) {
+  for (Array &array : arrays)
+    array.removeSwap(idx);
+}
+template <class Array, class... Arrays>
+inline void removeSwapAll(size_t idx, Array &array, Arrays &...arrays) {
+  removeSwapAll(idx, array);
+  removeSwapAll(idx, arrays...);
+}
+
+// pops every array passed in back down to size, so arrays kept in parallel
+// can be lined up again after an emplace failed partway through them
+template <class Array> inline void truncateAll(size_t size, Array &array) {
+  while (array.size() > size)
+    array.removeSwap(array.size() - 1);
+}
+template <class Array, size_t N> inline void truncateAll(size_t size, Array (&arrays)[N]) {
+  for (Array &array : arrays)
+    truncateAll(size, array);
+}
+template <class Array, class... Arrays>
+inline void truncateAll(size_t size, Array &array, Arrays &...arrays) {
+  truncateAll(size, array);
+  truncateAll(size, arrays...);
+}
+
 }
 
 #endif COMPONENT_ARRAY_H
\ No newline at end of file
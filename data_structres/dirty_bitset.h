@@ -0,0 +1,58 @@
+#ifndef DIRTY_BITSET_H
+#define DIRTY_BITSET_H
+
+#include "bit_ops.h"
+
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+namespace flux {
+
+// one bit per element, for keeping track of which elements changed since the
+// last clear. Grows as higher bits get set, anything past the end reads as 0.
+// NOTE setting bits that share a 64 bit word from different threads races,
+// so split parallel work on multiples of 64 elements
+class DirtyBitset {
+public:
+  inline void set(size_t idx) {
+    if ((idx >> 6) >= words_.size())
+      words_.resize((idx >> 6) + 1, 0);
+    words_[idx >> 6] |= (uint64_t)1 << (idx & 63);
+  }
+  inline void reset(size_t idx) {
+    if ((idx >> 6) < words_.size())
+      words_[idx >> 6] &= ~((uint64_t)1 << (idx & 63));
+  }
+  inline bool test(size_t idx) {
+    return (idx >> 6) < words_.size() && (words_[idx >> 6] >> (idx & 63)) & 1;
+  }
+  inline void clear() { std::fill(words_.begin(), words_.end(), 0); }
+
+  // calls func(idx) for every set bit in [begin, end) in increasing order,
+  // skipping over 64 clear bits at a time
+  template <class F> inline void forEach(size_t begin, size_t end, F func) {
+    end = std::min(end, words_.size() << 6);
+    if (begin >= end)
+      return;
+    size_t last_word = (end - 1) >> 6;
+    for (size_t word_idx = begin >> 6; word_idx <= last_word; word_idx++) {
+      uint64_t word = words_[word_idx];
+      if (word_idx == begin >> 6)
+        word &= ~(uint64_t)0 << (begin & 63);
+      if (word_idx == last_word && (end & 63))
+        word &= ~(~(uint64_t)0 << (end & 63));
+      while (word) {
+        func((word_idx << 6) + bits::lowestBit(word));
+        word &= word - 1;
+      }
+    }
+  }
+
+private:
+  std::vector<uint64_t> words_;
+};
+
+} // namespace flux
+
+#endif // DIRTY_BITSET_H
@@ -0,0 +1,98 @@
+#ifndef HANDLE_MAP_H
+#define HANDLE_MAP_H
+
+#include "../core/memory_manager.h"
+#include "component_array.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace flux {
+
+// hands out handles to things kept packed in [0, size()), like components in
+// arrays that are kept dense with removeSwap. A handle keeps pointing at the
+// same thing however often it gets moved around. Handles pack a sparse index
+// in the low half and a generation in the high half, the same as
+// MemoryManager's sections, so a removed handle never aliases a new one. 0 is
+// never a valid handle
+class HandleMap {
+public:
+  static constexpr uint32_t INVALID_IDX = 0xFFFFFFFF;
+
+  inline size_t size() { return dense_.size(); }
+  // the part of a handle that gets reused, for keying sparse arrays
+  inline static uint32_t getIndex(flux_id handle) { return (uint32_t)(handle & INDEX_MASK); }
+
+  // the new handle's dense index is always the old size()
+  inline flux_id create() {
+    uint32_t sparse_idx;
+    if (free_list_ != INVALID_IDX) {
+      sparse_idx = free_list_;
+      free_list_ = sparse_[sparse_idx].dense_idx;
+    } else {
+      sparse_idx = (uint32_t)sparse_.size();
+      sparse_.push_back(sparse_entry_t{INVALID_IDX, 1});
+    }
+    sparse_[sparse_idx].dense_idx = (uint32_t)dense_.size();
+    dense_.push_back(sparse_idx);
+    return makeHandle(sparse_idx);
+  }
+
+  inline uint32_t find(flux_id handle) {
+    flux_id sparse_idx = handle & INDEX_MASK;
+    if (sparse_idx >= sparse_.size() ||
+        sparse_[sparse_idx].generation != (handle >> INDEX_BITS))
+      return INVALID_IDX;
+    return sparse_[sparse_idx].dense_idx;
+  }
+  inline bool contains(flux_id handle) { return find(handle) != INVALID_IDX; }
+  inline flux_id getHandle(uint32_t dense_idx) { return makeHandle(dense_[dense_idx]); }
+
+  // moves the last entry into the hole left by handle, and swap removes the
+  // same index from every array passed in so they move along with it.
+  // Returns the index that was removed, or INVALID_IDX
+  template <class... Arrays> inline uint32_t remove(flux_id handle, Arrays &...arrays) {
+    uint32_t dense_idx = find(handle);
+    if (dense_idx == INVALID_IDX)
+      return INVALID_IDX;
+
+    uint32_t last = dense_.back();
+    dense_[dense_idx] = last;
+    sparse_[last].dense_idx = dense_idx;
+    dense_.pop_back();
+    removeArrays(dense_idx, arrays...);
+
+    // bump the generation so stale handles stop matching, skipping 0
+    sparse_entry_t &entry = sparse_[handle & INDEX_MASK];
+    entry.generation = (entry.generation + 1) & INDEX_MASK;
+    if (entry.generation == 0)
+      entry.generation = 1;
+    entry.dense_idx = free_list_;
+    free_list_ = (uint32_t)(handle & INDEX_MASK);
+    return dense_idx;
+  }
+
+private:
+  static constexpr size_t INDEX_BITS = sizeof(flux_id) * 4;
+  static constexpr flux_id INDEX_MASK = ((flux_id)1 << INDEX_BITS) - 1;
+
+  struct sparse_entry_t {
+    uint32_t dense_idx; // next free entry when on the free list
+    flux_id generation;
+  };
+  std::vector<sparse_entry_t> sparse_;
+  std::vector<uint32_t> dense_;
+  uint32_t free_list_ = INVALID_IDX;
+
+  inline flux_id makeHandle(uint32_t sparse_idx) {
+    return (sparse_[sparse_idx].generation << INDEX_BITS) | sparse_idx;
+  }
+  inline static void removeArrays(uint32_t) {}
+  template <class... Arrays> inline static void removeArrays(uint32_t idx, Arrays &...arrays) {
+    removeSwapAll(idx, arrays...);
+  }
+};
+
+} // namespace flux
+
+#endif // HANDLE_MAP_H
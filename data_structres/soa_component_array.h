@@ -0,0 +1,170 @@
+#ifndef SOA_COMPONENT_ARRAY_H
+#define SOA_COMPONENT_ARRAY_H
+
+#include "component_array.h"
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace flux {
+
+// a run of one field's values, which is all a kernel working on a single
+// field needs. Only good until the array it came from changes size or is
+// moved by a defrag
+template <class T> struct component_span_t {
+  T *data;
+  size_t size;
+
+  inline T &operator[](size_t idx) const { return data[idx]; }
+  inline T *begin() const { return data; }
+  inline T *end() const { return data + size; }
+};
+
+// every field of an SoAComponentArray is described by its own type, which
+// names the value stored for it, e.g. struct width_field_t { typedef float type; };
+template <class Field> struct soa_field_traits {
+  typedef typename Field::type type;
+};
+
+// position of Field in Fields
+template <class Field, class... Fields> struct soa_field_index;
+template <class Field, class... Fields>
+struct soa_field_index<Field, Field, Fields...> : std::integral_constant<size_t, 0> {};
+template <class Field, class Other, class... Fields>
+struct soa_field_index<Field, Other, Fields...>
+    : std::integral_constant<size_t, 1 + soa_field_index<Field, Fields...>::value> {};
+
+// a ComponentArray split up into one stream per field, each claimed from the
+// same MemoryManager and aligned on its own, so a loop that only needs a few
+// fields never pulls the rest through the cache. Every stream always holds the
+// same number of components
+template <class... Fields> class SoAComponentArray {
+public:
+  static constexpr size_t NUM_FIELDS = sizeof...(Fields);
+
+  template <class Field> using field_t = typename soa_field_traits<Field>::type;
+
+  inline static size_t claimSize(size_t max_components,
+                                 size_t alignment = COMPONENT_ALIGNMENT) {
+    size_t sizes[] = {ComponentArray<field_t<Fields>>::claimSize(max_components, alignment)...};
+    size_t total = 0;
+    for (size_t size : sizes)
+      total += size;
+    return total;
+  }
+
+  inline bool claimMemory(MemoryManager *memory_manager, size_t max_components,
+                          size_t alignment = COMPONENT_ALIGNMENT,
+                          memory_tag_t tag = MEMORY_TAG_UNTAGGED) {
+    bool success = true;
+    forEachStream([&](auto &stream) {
+      success = success && stream.claimMemory(memory_manager, max_components, alignment, tag);
+    });
+    // no stream keeps its memory unless they all got some
+    if (!success)
+      forEachStream([](auto &stream) { stream.releaseMemory(); });
+    return success;
+  }
+  inline bool reserveMemory(MemoryManager *memory_manager, size_t max_components,
+                            size_t initial_components = 0,
+                            size_t alignment = COMPONENT_ALIGNMENT,
+                            memory_tag_t tag = MEMORY_TAG_UNTAGGED) {
+    bool success = true;
+    forEachStream([&](auto &stream) {
+      success = success && stream.reserveMemory(memory_manager, max_components,
+                                                initial_components, alignment, tag);
+    });
+    if (!success)
+      forEachStream([](auto &stream) { stream.releaseMemory(); });
+    return success;
+  }
+
+  inline size_t size() { return std::get<0>(streams_).size(); }
+  inline size_t capacity() { return std::get<0>(streams_).capacity(); }
+
+  // one value per field, in the same order as Fields
+  inline bool emplace(const field_t<Fields> &...values) {
+    size_t idx = size();
+    if (!emplaceStreams(std::index_sequence_for<Fields...>(), values...))
+      return false;
+    dirty_.set(idx);
+    return true;
+  }
+  inline bool remove(size_t idx) {
+    size_t old_size = size();
+    bool success = true;
+    forEachStream([&](auto &stream) { success = stream.remove(idx) && success; });
+    if (success) {
+      for (size_t i = idx; i + 1 < old_size; i++)
+        dirty_.set(i);
+      dirty_.reset(old_size - 1);
+    }
+    return success;
+  }
+  inline bool removeSwap(size_t idx) {
+    size_t last = size() - 1;
+    bool success = true;
+    forEachStream([&](auto &stream) { success = stream.removeSwap(idx) && success; });
+    if (success) {
+      if (idx < last)
+        dirty_.set(idx);
+      dirty_.reset(last);
+    }
+    return success;
+  }
+
+  // dirty tracking is per component rather than per field, it works the same
+  // as ComponentArray's
+  template <class Field> inline field_t<Field> &modify(size_t idx) {
+    dirty_.set(idx);
+    return stream<Field>().buffer_[idx];
+  }
+  inline void markDirty(size_t idx) { dirty_.set(idx); }
+  inline bool isDirty(size_t idx) { return dirty_.test(idx); }
+  inline void clearDirty() { dirty_.clear(); }
+  template <class F> inline void forEachDirty(size_t begin, size_t end, F func) {
+    dirty_.forEach(begin, std::min(end, size()), func);
+  }
+  template <class F> inline void forEachDirty(F func) { dirty_.forEach(0, size(), func); }
+
+  template <class Field> inline ComponentArray<field_t<Field>> &stream() {
+    return std::get<soa_field_index<Field, Fields...>::value>(streams_);
+  }
+  template <class Field> inline field_t<Field> *data() { return stream<Field>().buffer_; }
+  template <class Field> inline component_span_t<field_t<Field>> span() {
+    ComponentArray<field_t<Field>> &field_stream = stream<Field>();
+    return component_span_t<field_t<Field>>{field_stream.buffer_, field_stream.size()};
+  }
+  template <class Field> inline field_t<Field> &get(size_t idx) {
+    return stream<Field>().buffer_[idx];
+  }
+
+private:
+  std::tuple<ComponentArray<field_t<Fields>>...> streams_;
+  DirtyBitset dirty_;
+
+  template <class F> inline void forEachStream(F func) {
+    forEachStream(func, std::index_sequence_for<Fields...>());
+  }
+  template <class F, size_t... I> inline void forEachStream(F &func, std::index_sequence<I...>) {
+    int expand[] = {0, (func(std::get<I>(streams_)), 0)...};
+    (void)expand;
+  }
+  // stops at the first stream that can't grow, and pops the ones before it
+  // so every stream stays the same size
+  template <size_t... I>
+  inline bool emplaceStreams(std::index_sequence<I...>, const field_t<Fields> &...values) {
+    size_t old_size = size();
+    bool success = true;
+    int expand[] = {0, (success = success && std::get<I>(streams_).emplace(values), 0)...};
+    (void)expand;
+    if (!success)
+      forEachStream([&](auto &stream) { truncateAll(old_size, stream); });
+    return success;
+  }
+};
+
+} // namespace flux
+
+#endif // SOA_COMPONENT_ARRAY_H
@@ -0,0 +1,71 @@
+#ifndef SPARSE_SET_H
+#define SPARSE_SET_H
+
+#include "../core/memory_manager.h"
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+namespace flux {
+
+// maps ids onto a packed range [0, size()). The sparse array is indexed by the
+// id itself, so lookups are a single load at the cost of memory proportional
+// to the largest id stored
+class SparseSet {
+public:
+  static constexpr uint32_t INVALID_IDX = 0xFFFFFFFF;
+
+  inline size_t size() { return dense_.size(); }
+  inline flux_id *ids() { return dense_.data(); }
+
+  inline uint32_t find(flux_id id) {
+    if (id >= sparse_.size())
+      return INVALID_IDX;
+    return sparse_[id];
+  }
+  inline bool contains(flux_id id) { return find(id) != INVALID_IDX; }
+
+  // returns the dense index of id, or INVALID_IDX if it was already in the set
+  inline uint32_t insert(flux_id id) {
+    if (contains(id))
+      return INVALID_IDX;
+    if (id >= sparse_.size())
+      sparse_.resize(id + 1, INVALID_IDX);
+    sparse_[id] = (uint32_t)dense_.size();
+    dense_.push_back(id);
+    return sparse_[id];
+  }
+  // moves the last id into the hole left by id, so any data kept in parallel
+  // with the dense array has to be swapped the same way
+  inline bool remove(flux_id id) {
+    uint32_t idx = find(id);
+    if (idx == INVALID_IDX)
+      return false;
+    flux_id last = dense_.back();
+    dense_[idx] = last;
+    sparse_[last] = idx;
+    dense_.pop_back();
+    sparse_[id] = INVALID_IDX;
+    return true;
+  }
+  // swaps two dense entries, data kept in parallel has to be swapped too
+  inline void swap(uint32_t idx1, uint32_t idx2) {
+    std::swap(dense_[idx1], dense_[idx2]);
+    sparse_[dense_[idx1]] = idx1;
+    sparse_[dense_[idx2]] = idx2;
+  }
+  inline void clear() {
+    for (flux_id id : dense_)
+      sparse_[id] = INVALID_IDX;
+    dense_.clear();
+  }
+
+private:
+  std::vector<uint32_t> sparse_;
+  std::vector<flux_id> dense_;
+};
+
+} // namespace flux
+
+#endif // SPARSE_SET_H
\ No newline at end of file
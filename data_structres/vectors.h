@@ -125,6 +125,52 @@ inline Vector3D operator/(const Vector3D &v, const float &c) {
 }
 // -------------------------------------
 
+// ----- 2D Affine Implementation ------
+// a 2x2 matrix, stored as the images of the x and y axes, followed by a
+// translation. Composing them is how a child's local transform is taken into
+// its parent's space
+struct Affine2D {
+  Vector2D x_axis, y_axis, trans;
+  Affine2D() : x_axis(1, 0), y_axis(0, 1) {}
+  Affine2D(const Vector2D &x_axis, const Vector2D &y_axis, const Vector2D &trans)
+      : x_axis(x_axis), y_axis(y_axis), trans(trans) {}
+  // same as v.rotate(cos_theta, sin_theta) + trans
+  inline static Affine2D fromRotation(float cos_theta, float sin_theta,
+                                      const Vector2D &trans) {
+    return Affine2D(Vector2D(cos_theta, sin_theta), Vector2D(-sin_theta, cos_theta), trans);
+  }
+
+  // transforms a direction, which ignores the translation
+  inline Vector2D applyVector(const Vector2D &v) const {
+    return Vector2D(x_axis.x * v.x + y_axis.x * v.y, x_axis.y * v.x + y_axis.y * v.y);
+  }
+  inline Vector2D applyPoint(const Vector2D &p) const {
+    Vector2D moved = applyVector(p);
+    return Vector2D(moved.x + trans.x, moved.y + trans.y);
+  }
+  // undefined if the matrix is singular
+  inline Affine2D inverse() const {
+    float inv_det = 1.0f / (x_axis.x * y_axis.y - y_axis.x * x_axis.y);
+    Affine2D inv(Vector2D(y_axis.y * inv_det, -x_axis.y * inv_det),
+                 Vector2D(-y_axis.x * inv_det, x_axis.x * inv_det), Vector2D());
+    inv.trans = -inv.applyVector(trans);
+    return inv;
+  }
+};
+
+inline bool operator==(const Affine2D &a1, const Affine2D &a2) {
+  return a1.x_axis == a2.x_axis && a1.y_axis == a2.y_axis && a1.trans == a2.trans;
+}
+inline bool operator!=(const Affine2D &a1, const Affine2D &a2) {
+  return !(a1 == a2);
+}
+// applies a2 first, then a1
+inline Affine2D operator*(const Affine2D &a1, const Affine2D &a2) {
+  return Affine2D(a1.applyVector(a2.x_axis), a1.applyVector(a2.y_axis),
+                  a1.applyPoint(a2.trans));
+}
+// -------------------------------------
+
 // ------- Vector Math Functions -------
 namespace vector {
 
@@ -12,10 +12,62 @@ bool runTests() {
   passed &= testMemoryManager();
 #endif
 
+#if TEST_FRAME_ARENA
+  passed &= testFrameArena();
+#endif
+
 #if TEST_COMPONENT_ARRAY
   passed &= testComponentArray();
 #endif
 
+#if TEST_SOA_COMPONENT_ARRAY
+  passed &= testSoAComponentArray();
+#endif
+
+#if TEST_SPARSE_SET
+  passed &= testSparseSet();
+#endif
+
+#if TEST_HANDLE_MAP
+  passed &= testHandleMap();
+#endif
+
+#if TEST_BROADPHASE
+  passed &= testBroadphase();
+#endif
+
+#if TEST_NARROWPHASE
+  passed &= testNarrowphase();
+#endif
+
+#if TEST_BATCH_MATH
+  passed &= testBatchMath();
+#endif
+
+#if TEST_AABB_TREE
+  passed &= testAABBTree();
+#endif
+
+#if TEST_TILEMAP_COLLIDER
+  passed &= testTilemapCollider();
+#endif
+
+#if TEST_JOB_SYSTEM
+  passed &= testJobSystem();
+#endif
+
+#if TEST_ENTITY_REGISTRY
+  passed &= testEntityRegistry();
+#endif
+
+#if TEST_TRANSFORM_MANAGER
+  passed &= testTransformManager();
+#endif
+
+#if TEST_COLLISION_MANAGER
+  passed &= testCollisionManager();
+#endif
+
   if (passed)
     printf("Passed all core tests!\n");
   return passed;
@@ -108,6 +160,210 @@ bool testMemoryManager() {
   TEST_CONDITION(!manager.claimSection(sizeof(float) * 2, id1), passed,
                  "manager failed to allocate space when it should be able to do so")
 
+  // handles to freed sections should stay dead even once the slot is reused
+  flux::flux_id stale_id = id2;
+  TEST_CONDITION(!manager.freeSection(id2), passed, "failed to free a section\n")
+  TEST_CONDITION(manager.isValid(stale_id), passed, "freed handle was still valid\n")
+  TEST_CONDITION(!manager.claimSection(sizeof(float), id2), passed,
+                 "Manager failed to give space\n")
+  TEST_CONDITION(id2 == stale_id || manager.getSection(stale_id), passed,
+                 "stale handle aliased a new section\n")
+  TEST_CONDITION(manager.freeSection(stale_id), passed, "freed a stale handle\n")
+  TEST_CONDITION(manager.freeSection(0), passed, "freed the null handle\n")
+
+  // there is no cap on the number of sections, only on memory
+  flux::MemoryManager many_manager;
+  const size_t num_sections = 1000;
+  many_manager.allocMemory(sizeof(float) * num_sections);
+  std::vector<flux::flux_id> ids(num_sections);
+  bool many_valid = true;
+  for (size_t i = 0; i < num_sections; i++) {
+    float *section = static_cast<float *>(many_manager.claimSection(sizeof(float), ids[i]));
+    many_valid &= section != nullptr;
+    if (section)
+      *section = (float)i;
+  }
+  for (size_t i = 0; i < num_sections; i += 2)
+    many_valid &= many_manager.freeSection(ids[i]);
+  for (size_t i = 1; i < num_sections; i += 2)
+    many_valid &= *static_cast<float *>(many_manager.getSection(ids[i])) == (float)i;
+  many_valid &= many_manager.getNumSections() == num_sections / 2;
+  TEST_CONDITION(!many_valid, passed, "manager failed to handle many sections\n")
+
+  // random claims and frees should never hand out overlapping sections, and
+  // freeing everything should merge back into a single block
+  flux::MemoryManager churn_manager;
+  const size_t churn_size = 1 << 16;
+  churn_manager.allocMemory(churn_size);
+  std::vector<std::pair<flux::flux_id, size_t>> live;
+  std::vector<uint8_t> owner(churn_size, 0);
+  bool churn_valid = true;
+  srand(1357);
+  for (int i = 0; i < 5000; i++) {
+    if (live.empty() || rand() % 3 != 0) {
+      size_t size = 1 + rand() % 700;
+      flux::flux_id id;
+      char *section = static_cast<char *>(churn_manager.claimSection(size, id));
+      if (!section)
+        continue;
+      live.push_back(std::make_pair(id, size));
+    } else {
+      size_t idx = rand() % live.size();
+      churn_valid &= churn_manager.freeSection(live[idx].first);
+      live[idx] = live.back();
+      live.pop_back();
+    }
+  }
+  // mark every live section's bytes and make sure nothing was marked twice
+  char *base = nullptr;
+  for (auto &section : live) {
+    char *ptr = static_cast<char *>(churn_manager.getSection(section.first));
+    if (!base || ptr < base)
+      base = ptr;
+  }
+  size_t total_live = 0;
+  for (auto &section : live) {
+    char *ptr = static_cast<char *>(churn_manager.getSection(section.first));
+    for (size_t j = 0; j < section.second; j++) {
+      size_t byte = ptr - base + j;
+      churn_valid &= byte < churn_size && !owner[byte];
+      if (byte < churn_size)
+        owner[byte] = 1;
+    }
+    total_live += section.second;
+  }
+  churn_valid &= churn_manager.getAmountClaimed() == total_live;
+  TEST_CONDITION(!churn_valid, passed, "manager handed out overlapping sections\n")
+  float fragmentation = churn_manager.getFragmentation();
+  TEST_CONDITION(fragmentation < 0.0f || fragmentation > 1.0f, passed,
+                 "fragmentation was out of range\n")
+  for (auto &section : live)
+    churn_manager.freeSection(section.first);
+  TEST_CONDITION(churn_manager.getNumFreeBlocks() != 1 ||
+                     churn_manager.getLargestFreeBlock() != churn_size ||
+                     churn_manager.getFragmentation() != 0.0f,
+                 passed, "freed blocks were not merged back together\n")
+
+  // aligned sections should start on the boundary asked for, even after
+  // being slid down by a defrag
+  flux::MemoryManager aligned_manager;
+  aligned_manager.allocMemory(4096);
+  flux::flux_id small_id, aligned_id, wide_id;
+  TEST_CONDITION(aligned_manager.claimSection(8, small_id, 3), passed,
+                 "claimed a section with a non power of two alignment\n")
+  aligned_manager.claimSection(3, small_id);
+  void *aligned = aligned_manager.claimSection(100, aligned_id, 64);
+  void *wide = aligned_manager.claimSection(10, wide_id, 256);
+  TEST_CONDITION(!aligned || (uintptr_t)aligned % 64 || !wide || (uintptr_t)wide % 256,
+                 passed, "claimed section was not aligned\n")
+  if (aligned)
+    *static_cast<float *>(aligned) = a;
+  aligned_manager.freeSection(small_id);
+  aligned_manager.defrag();
+  aligned = aligned_manager.getSection(aligned_id);
+  wide = aligned_manager.getSection(wide_id);
+  TEST_CONDITION((uintptr_t)aligned % 64 || (uintptr_t)wide % 256 ||
+                     *static_cast<float *>(aligned) != a,
+                 passed, "defrag broke a section's alignment\n")
+
+  // an incremental defrag should only move about as much as it is allowed to
+  // each step, tell owners where their sections went, and end up with the
+  // same single free block as a full defrag
+  flux::MemoryManager step_manager;
+  const size_t step_sections = 64;
+  step_manager.allocMemory(step_sections * 64);
+  std::vector<flux::flux_id> step_ids(step_sections);
+  std::vector<float *> step_ptrs(step_sections, nullptr);
+  for (size_t i = 0; i < step_sections; i++) {
+    step_ptrs[i] = static_cast<float *>(step_manager.claimSection(64, step_ids[i], 64));
+    if (step_ptrs[i])
+      *step_ptrs[i] = (float)i;
+    step_manager.setRelocateCallback(step_ids[i], [&step_ptrs, i](flux::flux_data_ptr ptr) {
+      step_ptrs[i] = static_cast<float *>(ptr);
+    });
+  }
+  for (size_t i = 0; i < step_sections; i += 2)
+    step_manager.freeSection(step_ids[i]);
+  int num_steps = 0;
+  while (!step_manager.defragStep(128) && num_steps < 100)
+    num_steps++;
+  bool step_valid = num_steps >= (int)step_sections / 4 - 1 && num_steps < 100;
+  for (size_t i = 1; i < step_sections; i += 2) {
+    step_valid &= step_ptrs[i] == step_manager.getSection(step_ids[i]);
+    step_valid &= step_ptrs[i] && *step_ptrs[i] == (float)i;
+  }
+  step_valid &= step_manager.getNumFreeBlocks() == 1 &&
+                step_manager.getLargestFreeBlock() == step_sections * 32;
+  TEST_CONDITION(!step_valid, passed, "incremental defrag failed to compact memory\n")
+
+  // a reserved block should only commit what sections ask for, and growing a
+  // section should never move it
+  flux::MemoryManager reserved_manager;
+  TEST_CONDITION(!reserved_manager.reserveMemory(1 << 24), passed,
+                 "failed to reserve memory\n")
+  flux::flux_id lazy_id;
+  float *lazy = static_cast<float *>(reserved_manager.reserveSection(1 << 20, lazy_id, 64));
+  TEST_CONDITION(!lazy || reserved_manager.getAmountCommitted() != 0, passed,
+                 "reserving a section committed memory\n")
+  TEST_CONDITION(!reserved_manager.commitSection(lazy_id, 64), passed,
+                 "failed to commit part of a section\n")
+  if (lazy)
+    lazy[0] = a;
+  TEST_CONDITION(!reserved_manager.commitSection(lazy_id, 1 << 19), passed,
+                 "failed to commit more of a section\n")
+  if (lazy)
+    lazy[(1 << 17) - 1] = b;
+  TEST_CONDITION(reserved_manager.commitSection(lazy_id, (1 << 20) + 1), passed,
+                 "committed past the end of a section\n")
+  TEST_CONDITION(reserved_manager.getSection(lazy_id) != lazy ||
+                     reserved_manager.getAmountCommitted() != 1 << 19 ||
+                     lazy[0] != a || lazy[(1 << 17) - 1] != b,
+                 passed, "committing more of a section broke it\n")
+
+  // stats should follow claims and frees, both for the whole manager and for
+  // whatever tag each claim was made under
+  flux::MemoryManager stats_manager;
+  stats_manager.allocMemory(1024);
+  flux::memory_tag_t stats_tag = stats_manager.registerTag("stats");
+  flux::flux_id tagged_id, untagged_id;
+  stats_manager.claimSection(256, tagged_id, 1, stats_tag);
+  stats_manager.claimSection(512, untagged_id);
+  stats_manager.claimSection(512, untagged_id, 1, stats_tag);
+  stats_manager.recordFrame();
+  stats_manager.freeSection(tagged_id);
+  stats_manager.recordFrame();
+  flux::memory_stats_t stats = stats_manager.getStats();
+  const flux::memory_tag_stats_t &tag_stats = stats_manager.getTagStats(stats_tag);
+  TEST_CONDITION(stats.live_sections != 1 || stats.claimed != 512 || stats.high_water != 768 ||
+                     stats.num_claims != 2 || stats.num_failed_claims != 1 ||
+                     stats.num_frees != 1 || stats.largest_free_block != 256,
+                 passed, "manager stats were wrong\n")
+  TEST_CONDITION(tag_stats.name != "stats" || tag_stats.live_sections != 0 ||
+                     tag_stats.high_water != 256 || tag_stats.num_claims != 1 ||
+                     tag_stats.num_failed_claims != 1 || tag_stats.num_frees != 1,
+                 passed, "tag stats were wrong\n")
+
+  // the only free block is exactly sized and already aligned, so the claim
+  // has to come from the slow search, and should show up in the stats
+  flux::MemoryManager slow_manager;
+  slow_manager.allocMemory(1024);
+  flux::flux_id exact_id, rest_id;
+  slow_manager.claimSection(100, exact_id);
+  slow_manager.claimSection(924, rest_id);
+  slow_manager.freeSection(exact_id);
+  uint64_t slow_searches = slow_manager.getStats().num_slow_searches;
+  TEST_CONDITION(!slow_manager.claimSection(100, exact_id, 64) ||
+                     slow_manager.getStats().num_slow_searches != slow_searches + 1,
+                 passed, "slow search missed an exactly sized block\n")
+
+  // huge pages are only a hint, so the block should work either way
+  flux::MemoryManager huge_manager;
+  TEST_CONDITION(!huge_manager.allocMemory(4 << 20, true), passed,
+                 "failed to allocate a huge page backed block\n")
+  flux::flux_id huge_id;
+  TEST_CONDITION(!huge_manager.claimSection(1 << 20, huge_id, 64), passed,
+                 "failed to claim from a huge page backed block\n")
+
 
   if (passed)
     printf("MemoryManager passed all tests!\n");
@@ -182,6 +438,18 @@ bool testVectors() {
   TEST_CONDITION(flux::vector::cross(v3_1, v3_2) != flux::Vector3D(0.0, -1.0, 1.0), passed,
     "Vector3D cross product not working properly")
 
+  auto a_1 = flux::Affine2D::fromRotation(0.0, 1.0, flux::Vector2D(1.0, 2.0));
+  auto a_2 = flux::Affine2D(flux::Vector2D(2.0, 0.0), flux::Vector2D(0.0, 2.0),
+                            flux::Vector2D(0.0, 1.0));
+  TEST_CONDITION(a_1.applyPoint(v2_2) != v2_2.rotate(0.0, 1.0) + flux::Vector2D(1.0, 2.0),
+    passed, "Affine2D fromRotation not working properly")
+  TEST_CONDITION(a_1.applyVector(v2_2) != flux::Vector2D(-4.0, 3.0), passed,
+    "Affine2D applyVector not working properly")
+  TEST_CONDITION((a_1 * a_2).applyPoint(v2_2) != a_1.applyPoint(a_2.applyPoint(v2_2)), passed,
+    "Affine2D operator* not working properly")
+  TEST_CONDITION(a_2.inverse() * a_2 != flux::Affine2D() || a_1 * a_1.inverse() != flux::Affine2D(),
+    passed, "Affine2D inverse not working properly")
+
   if (passed)
     printf("Vectors passed all tests!\n");
 
@@ -199,6 +467,8 @@ bool testComponentArray() {
   TEST_CONDITION(arr.claimMemory(&memory_manager, 4), passed,
                  "claimMemory claimed more than it should be able to\n");
   TEST_CONDITION(!arr.claimMemory(&memory_manager, 3), passed, "claimMemory failed\n");
+  TEST_CONDITION((uintptr_t)arr.buffer_ % flux::COMPONENT_ALIGNMENT, passed,
+                 "array was not cache line aligned\n");
   TEST_CONDITION(arr.claimMemory(&memory_manager, 1), passed,
                  "claimMemory should only be able to be called once\n");
   TEST_CONDITION(arr.size() != 0, passed, "size was incorrect for empty array\n")
@@ -223,7 +493,1284 @@ bool testComponentArray() {
   TEST_CONDITION(!arr.remove(0), passed, "failed to remove final element\n")
   TEST_CONDITION(arr.remove(0), passed, "removed element from empty list\n")
 
+  // swap removes should keep parallel arrays lined up
+  flux::MemoryManager swap_manager;
+  swap_manager.allocMemory(flux::ComponentArray<int>::claimSize(4) * 3);
+  flux::ComponentArray<int> swap_ints, swap_more[2];
+  swap_ints.claimMemory(&swap_manager, 4);
+  for (auto &more : swap_more)
+    more.claimMemory(&swap_manager, 4);
+  for (int i = 0; i < 4; i++) {
+    swap_ints.emplace(i);
+    for (auto &more : swap_more)
+      more.emplace(i * 10);
+  }
+  flux::removeSwapAll(1, swap_ints, swap_more);
+  TEST_CONDITION(swap_ints.size() != 3 || swap_ints.buffer_[1] != 3 ||
+                     swap_more[0].buffer_[1] != 30 || swap_more[1].buffer_[1] != 30 ||
+                     swap_more[1].size() != 3,
+                 passed, "swap remove did not move the last element into the hole\n")
+
+  // only components that were added, moved or modified should be dirty
+  swap_ints.clearDirty();
+  swap_ints.modify(2) = 5;
+  swap_ints.emplace(6);
+  std::vector<size_t> dirty;
+  swap_ints.forEachDirty([&](size_t idx) { dirty.push_back(idx); });
+  TEST_CONDITION(dirty.size() != 2 || dirty[0] != 2 || dirty[1] != 3 ||
+                     swap_ints.buffer_[2] != 5,
+                 passed, "modify and emplace did not mark the right components\n")
+  swap_ints.clearDirty();
+  swap_ints.removeSwap(0);
+  TEST_CONDITION(!swap_ints.isDirty(0) || swap_ints.isDirty(1) || swap_ints.isDirty(3), passed,
+                 "swap remove did not mark the moved component\n")
+  dirty.clear();
+  swap_ints.forEachDirty(1, 3, [&](size_t idx) { dirty.push_back(idx); });
+  TEST_CONDITION(!dirty.empty(), passed, "forEachDirty went outside its range\n")
+
+  // arrays in reserved memory should grow in place as they fill up
+  flux::MemoryManager growing_manager;
+  growing_manager.reserveMemory(flux::ComponentArray<float>::claimSize(1 << 16));
+  flux::ComponentArray<float> growing;
+  TEST_CONDITION(!growing.reserveMemory(&growing_manager, 1 << 16, 4), passed,
+                 "reserveMemory failed\n")
+  float *first_buffer = growing.buffer_;
+  bool grew = growing.capacity() == 4;
+  for (int i = 0; i < 1000; i++)
+    grew &= growing.emplace((float)i);
+  for (int i = 0; i < 1000; i++)
+    grew &= growing.buffer_[i] == (float)i;
+  grew &= growing.buffer_ == first_buffer && growing.capacity() >= 1000;
+  grew &= growing_manager.getAmountCommitted() < sizeof(float) * (1 << 16);
+  TEST_CONDITION(!grew, passed, "array failed to grow in place\n")
+
+  // arrays should keep working after a defrag moves them
+  flux::MemoryManager moving_manager;
+  moving_manager.allocMemory(flux::ComponentArray<float>::claimSize(2) * 2);
+  flux::flux_id blocker_id;
+  moving_manager.claimSection(sizeof(float) * 2, blocker_id, flux::COMPONENT_ALIGNMENT);
+  flux::ComponentArray<float> moving;
+  moving.claimMemory(&moving_manager, 2);
+  moving.emplace(4.0f);
+  moving.emplace(5.0f);
+  float *old_buffer = moving.buffer_;
+  moving_manager.freeSection(blocker_id);
+  moving_manager.defrag();
+  TEST_CONDITION(moving.buffer_ == old_buffer || moving.buffer_[0] != 4.0f ||
+                     moving.buffer_[1] != 5.0f,
+                 passed, "array was not fixed up after a defrag\n")
+
   if (passed)
     printf("ComponentArray passed all tests!\n");
   return passed;
-}
\ No newline at end of file
+}
+
+bool testBroadphase() {
+  bool passed = true;
+  printf("Testing Broadphase ...\n");
+
+  // scatter boxes of a few different sizes, some spanning multiple cells
+  const size_t num_bounds = 200;
+  flux::aabb_t bounds[num_bounds];
+  srand(1234);
+  for (size_t i = 0; i < num_bounds; i++) {
+    flux::Vector2D min((rand() % 1000) / 100.0f - 5.0f, (rand() % 1000) / 100.0f - 5.0f);
+    flux::Vector2D size((rand() % 100) / 100.0f, (rand() % 100) / 100.0f);
+    bounds[i] = flux::aabb_t(min, min + size);
+  }
+
+  // brute force pairs are the reference for everything else
+  std::vector<flux::collision_pair_t> expected;
+  flux::findAllPairs(bounds, num_bounds, expected);
+
+  flux::SpatialHash spatial_hash(0.25f);
+  std::vector<flux::collision_pair_t> pairs;
+  spatial_hash.rebuild(bounds, num_bounds);
+  spatial_hash.findPairs(pairs);
+  TEST_CONDITION(pairs.size() != expected.size(), passed,
+                 "SpatialHash found the wrong number of pairs\n")
+
+  bool pairs_valid = true;
+  for (auto &pair : pairs) {
+    pairs_valid &= pair.a < pair.b && flux::aabb::overlaps(bounds[pair.a], bounds[pair.b]);
+    for (auto &other : pairs)
+      pairs_valid &= &pair == &other || pair.a != other.a || pair.b != other.b;
+  }
+  TEST_CONDITION(!pairs_valid, passed, "SpatialHash returned an invalid pair\n")
+
+  // changing the cell size should not change the result
+  spatial_hash.setCellSize(2.0f);
+  spatial_hash.rebuild(bounds, num_bounds);
+  pairs.clear();
+  spatial_hash.findPairs(pairs);
+  TEST_CONDITION(pairs.size() != expected.size(), passed,
+                 "SpatialHash found the wrong number of pairs with large cells\n")
+
+  // region queries should find each overlapping box exactly once
+  bool query_valid = true;
+  std::vector<uint32_t> hits;
+  for (int i = 0; i < 20; i++) {
+    flux::Vector2D min((rand() % 1000) / 100.0f - 5.0f, (rand() % 1000) / 100.0f - 5.0f);
+    flux::aabb_t region(min, min + flux::Vector2D(3.0f, 0.5f));
+    hits.clear();
+    spatial_hash.query(region, hits);
+    size_t num_expected = 0;
+    for (size_t j = 0; j < num_bounds; j++)
+      num_expected += flux::aabb::overlaps(bounds[j], region);
+    query_valid &= hits.size() == num_expected;
+    for (uint32_t hit : hits)
+      query_valid &= flux::aabb::overlaps(bounds[hit], region);
+  }
+  TEST_CONDITION(!query_valid, passed, "SpatialHash query did not match brute force\n")
+
+  // jitter the boxes over a few frames and make sure sweep and prune keeps up
+  flux::SweepAndPrune sweep_and_prune;
+  bool sweep_valid = true;
+  for (int frame = 0; frame < 10; frame++) {
+    size_t frame_bounds = frame < 8 ? num_bounds : num_bounds / 2;
+    sweep_and_prune.update(bounds, frame_bounds);
+    expected.clear();
+    flux::findAllPairs(bounds, frame_bounds, expected);
+    pairs.clear();
+    sweep_and_prune.findPairs(pairs);
+    sweep_valid &= pairs.size() == expected.size();
+    for (size_t i = 0; i < pairs.size(); i++) {
+      flux::collision_pair_t &pair = pairs[i];
+      sweep_valid &= pair.a < pair.b && flux::aabb::overlaps(bounds[pair.a], bounds[pair.b]);
+      // pairs come out sorted, with no repeats
+      if (i > 0)
+        sweep_valid &= pairs[i - 1].a < pair.a || (pairs[i - 1].a == pair.a &&
+                                                   pairs[i - 1].b < pair.b);
+    }
+
+    for (size_t i = 0; i < num_bounds; i++) {
+      flux::Vector2D step((rand() % 21 - 10) / 100.0f, (rand() % 21 - 10) / 100.0f);
+      bounds[i].min += step;
+      bounds[i].max += step;
+    }
+  }
+  TEST_CONDITION(!sweep_valid, passed, "SweepAndPrune pairs did not match brute force\n")
+
+  // remove two boxes the way CollisionManager does, the last box moves into
+  // one slot and a brand new box takes the other
+  uint32_t remap_bounds = num_bounds / 2;
+  std::vector<uint32_t> new_idxs(remap_bounds);
+  for (uint32_t i = 0; i < remap_bounds; i++)
+    new_idxs[i] = i;
+  remap_bounds--;
+  new_idxs[3] = flux::SweepAndPrune::REMOVED_IDX;
+  new_idxs[remap_bounds] = 3;
+  bounds[3] = bounds[remap_bounds];
+  new_idxs[0] = flux::SweepAndPrune::REMOVED_IDX;
+  bounds[0] = flux::aabb_t(bounds[1].min, bounds[1].min + flux::Vector2D(1.0f, 1.0f));
+  sweep_and_prune.remap(new_idxs.data());
+  sweep_and_prune.update(bounds, remap_bounds);
+  expected.clear();
+  flux::findAllPairs(bounds, remap_bounds, expected);
+  pairs.clear();
+  sweep_and_prune.findPairs(pairs);
+  bool remap_valid = pairs.size() == expected.size();
+  for (size_t i = 0; remap_valid && i < pairs.size(); i++)
+    remap_valid &= pairs[i].a == expected[i].a && pairs[i].b == expected[i].b;
+  TEST_CONDITION(!remap_valid, passed, "SweepAndPrune pairs were wrong after a remap\n")
+
+  if (passed)
+    printf("Broadphase passed all tests!\n");
+  return passed;
+}
+
+bool testNarrowphase() {
+  bool passed = true;
+  printf("Testing Narrowphase ...\n");
+
+  // build the SAT streams for a bunch of randomly rotated rectangles
+  const size_t num_rects = 203; // leaves a tail for every SIMD width
+  std::vector<float> streams[flux::SAT_NUM_STREAMS];
+  flux::sat_streams_t sat_streams;
+  srand(4321);
+  for (auto &stream : streams)
+    stream.resize(num_rects);
+  for (int i = 0; i < flux::SAT_NUM_STREAMS; i++)
+    sat_streams.stream[i] = streams[i].data();
+
+  for (size_t i = 0; i < num_rects; i++) {
+    flux::Vector2D center((rand() % 400) / 100.0f, (rand() % 400) / 100.0f);
+    float half_width = (rand() % 50 + 1) / 100.0f;
+    float half_height = (rand() % 50 + 1) / 100.0f;
+    float rot = (rand() % 628) / 100.0f;
+    float cos_rot = cosf(rot), sin_rot = sinf(rot);
+    // first two rectangles are exact copies so we know they hit
+    if (i == 1) {
+      for (auto &stream : streams)
+        stream[1] = stream[0];
+      continue;
+    }
+
+    flux::Vector2D axes[2] = {flux::Vector2D(-sin_rot, cos_rot),
+                              flux::Vector2D(cos_rot, sin_rot)};
+    flux::Vector2D corners[4] = {
+      flux::Vector2D(half_width, half_height).rotate(cos_rot, sin_rot) + center,
+      flux::Vector2D(-half_width, half_height).rotate(cos_rot, sin_rot) + center,
+      flux::Vector2D(-half_width, -half_height).rotate(cos_rot, sin_rot) + center,
+      flux::Vector2D(half_width, -half_height).rotate(cos_rot, sin_rot) + center
+    };
+    for (int j = 0; j < 4; j++) {
+      streams[flux::SAT_V1_X + 2 * j][i] = corners[j].x;
+      streams[flux::SAT_V1_Y + 2 * j][i] = corners[j].y;
+    }
+    for (int j = 0; j < 2; j++) {
+      float min = flux::vector::dot(axes[j], corners[0]);
+      float max = min;
+      for (int k = 1; k < 4; k++) {
+        min = fminf(min, flux::vector::dot(axes[j], corners[k]));
+        max = fmaxf(max, flux::vector::dot(axes[j], corners[k]));
+      }
+      streams[flux::SAT_AXIS1_X + 2 * j][i] = axes[j].x;
+      streams[flux::SAT_AXIS1_Y + 2 * j][i] = axes[j].y;
+      streams[flux::SAT_MIN1 + 2 * j][i] = min;
+      streams[flux::SAT_MAX1 + 2 * j][i] = max;
+    }
+  }
+
+  std::vector<uint32_t> candidates;
+  for (uint32_t i = 1; i < num_rects; i++)
+    candidates.push_back(i);
+  std::vector<uint8_t> expected(candidates.size());
+  std::vector<uint8_t> hits(candidates.size());
+
+  // every supported SIMD path has to agree exactly with the scalar one
+  bool paths_match = true;
+  size_t num_hits = 0, num_tested = 0;
+  for (uint32_t outer = 0; outer < 8; outer++) {
+    flux::satTest(flux::SIMD_SCALAR, sat_streams, outer, candidates.data() + outer,
+                  candidates.size() - outer, expected.data());
+    for (size_t i = 0; i + outer < candidates.size(); i++)
+      num_hits += expected[i];
+    num_tested += candidates.size() - outer;
+
+    flux::simd_level_t levels[2] = {flux::SIMD_SSE2, flux::SIMD_AVX2};
+    for (auto level : levels) {
+      if (level > flux::cpu::getSimdLevel())
+        continue;
+      flux::satTest(level, sat_streams, outer, candidates.data() + outer,
+                    candidates.size() - outer, hits.data());
+      for (size_t i = 0; i + outer < candidates.size(); i++)
+        paths_match &= hits[i] == expected[i];
+    }
+  }
+  TEST_CONDITION(!paths_match, passed, "SIMD narrowphase disagreed with scalar path\n")
+
+  flux::satTest(flux::SIMD_SCALAR, sat_streams, 0, candidates.data(), 1, hits.data());
+  TEST_CONDITION(!hits[0], passed, "identical rectangles were not colliding\n")
+  TEST_CONDITION(num_hits == 0 || num_hits == num_tested, passed,
+                 "narrowphase gave a trivial answer for random rectangles\n")
+
+  if (passed)
+    printf("Narrowphase passed all tests!\n");
+  return passed;
+}
+
+bool testBatchMath() {
+  bool passed = true;
+  printf("Testing batch math ...\n");
+
+  // odd sized and off by one from the start, so every path hits its leftovers
+  // and unaligned loads
+  const size_t count = 101;
+  std::vector<float> streams[8];
+  srand(4321);
+  for (auto &stream : streams) {
+    stream.resize(count + 1);
+    for (auto &value : stream)
+      value = (rand() % 2000) / 100.0f - 10.0f;
+  }
+  streams[0][5] = streams[1][5] = 0.0f; // a zero vector to normalize
+  for (size_t i = 0; i <= count; i++) {
+    float angle = streams[2][i];
+    streams[2][i] = cosf(angle);
+    streams[3][i] = sinf(angle);
+  }
+  const float *x = streams[0].data() + 1, *y = streams[1].data() + 1;
+  const float *cos_rot = streams[2].data() + 1, *sin_rot = streams[3].data() + 1;
+  const float *other_x = streams[4].data() + 1, *other_y = streams[5].data() + 1;
+  flux::Vector2D axis(0.6f, -0.8f);
+
+  // the scalar path should match the Vector2D operators it replaces
+  std::vector<float> expected[7];
+  for (auto &stream : expected)
+    stream.resize(count);
+  float expected_min, expected_max;
+  flux::batch::rotateTranslate(flux::SIMD_SCALAR, x, y, cos_rot, sin_rot, other_x, other_y,
+                               count, expected[0].data(), expected[1].data());
+  flux::batch::dotMinMax(flux::SIMD_SCALAR, x, y, count, axis, expected[2].data(),
+                         expected_min, expected_max);
+  flux::batch::normalize(flux::SIMD_SCALAR, x, y, count, expected[3].data(),
+                         expected[4].data());
+  flux::batch::lerp(flux::SIMD_SCALAR, x, y, other_x, other_y, 0.25f, count,
+                    expected[5].data(), expected[6].data());
+  bool scalar_valid = true;
+  float min = INFINITY, max = -INFINITY;
+  for (size_t i = 0; i < count; i++) {
+    flux::Vector2D v(x[i], y[i]), other(other_x[i], other_y[i]);
+    flux::Vector2D moved = v.rotate(cos_rot[i], sin_rot[i]) + other;
+    float proj = flux::vector::dot(axis, v);
+    flux::Vector2D unit = v.magnitude() != 0.0f ? v / v.magnitude() : flux::Vector2D();
+    flux::Vector2D mixed = v + (other - v) * 0.25f;
+    scalar_valid &= moved.x == expected[0][i] && moved.y == expected[1][i] &&
+                    proj == expected[2][i] && unit.x == expected[3][i] &&
+                    unit.y == expected[4][i] && mixed.x == expected[5][i] &&
+                    mixed.y == expected[6][i];
+    min = std::min(min, proj);
+    max = std::max(max, proj);
+  }
+  scalar_valid &= min == expected_min && max == expected_max;
+  TEST_CONDITION(!scalar_valid, passed, "scalar batch math disagreed with Vector2D\n")
+
+  // every supported SIMD path has to agree exactly with the scalar one
+  bool paths_match = true;
+  flux::simd_level_t levels[3] = {flux::SIMD_SSE2, flux::SIMD_AVX2, flux::SIMD_AVX512};
+  for (auto level : levels) {
+    if (level > flux::cpu::getSimdLevel())
+      continue;
+    std::vector<float> results[7];
+    for (auto &stream : results)
+      stream.resize(count);
+    flux::batch::rotateTranslate(level, x, y, cos_rot, sin_rot, other_x, other_y, count,
+                                 results[0].data(), results[1].data());
+    flux::batch::dotMinMax(level, x, y, count, axis, results[2].data(), min, max);
+    flux::batch::normalize(level, x, y, count, results[3].data(), results[4].data());
+    flux::batch::lerp(level, x, y, other_x, other_y, 0.25f, count, results[5].data(),
+                      results[6].data());
+    for (int i = 0; i < 7; i++)
+      paths_match &= results[i] == expected[i];
+    paths_match &= min == expected_min && max == expected_max;
+  }
+  TEST_CONDITION(!paths_match, passed, "SIMD batch math disagreed with scalar path\n")
+
+  // sinCos is only close to the C library, but every path has to agree
+  std::vector<float> angles(count), sins(count), coses(count);
+  for (size_t i = 0; i < count; i++)
+    angles[i] = (i % 2 ? -1.0f : 1.0f) * i * i * 0.8f;
+  flux::batch::sinCos(flux::SIMD_SCALAR, angles.data(), count, sins.data(), coses.data());
+  bool sin_cos_close = true;
+  for (size_t i = 0; i < count; i++) {
+    sin_cos_close &= fabs(sins[i] - sin((double)angles[i])) <= 1e-7 &&
+                     fabs(coses[i] - cos((double)angles[i])) <= 1e-7;
+  }
+  TEST_CONDITION(!sin_cos_close, passed, "sinCos was not within its documented error\n")
+  bool sin_cos_match = true;
+  for (auto level : levels) {
+    if (level > flux::cpu::getSimdLevel())
+      continue;
+    std::vector<float> level_sins(count), level_coses(count);
+    flux::batch::sinCos(level, angles.data(), count, level_sins.data(), level_coses.data());
+    sin_cos_match &= level_sins == sins && level_coses == coses;
+  }
+  TEST_CONDITION(!sin_cos_match, passed, "SIMD sinCos disagreed with scalar path\n")
+
+  flux::batch::dotMinMax(x, y, 0, axis, nullptr, min, max);
+  TEST_CONDITION(min != INFINITY || max != -INFINITY, passed,
+                 "empty dotMinMax did not give empty bounds\n")
+
+  if (passed)
+    printf("Batch math passed all tests!\n");
+  return passed;
+}
+
+bool testJobSystem() {
+  bool passed = true;
+  printf("Testing JobSystem ...\n");
+
+  flux::JobSystem serial_jobs(1);
+  flux::JobSystem jobs(4);
+  TEST_CONDITION(serial_jobs.getNumThreads() != 1, passed,
+                 "serial JobSystem reported the wrong thread count\n")
+  TEST_CONDITION(jobs.getNumThreads() != 4, passed,
+                 "JobSystem reported the wrong thread count\n")
+
+  // every task should run exactly once, on a valid thread
+  const size_t num_tasks = 1000;
+  std::vector<std::atomic<int>> runs(num_tasks);
+  std::atomic<bool> bad_thread(false);
+  for (int round = 0; round < 3; round++) {
+    jobs.parallelFor(num_tasks, [&](size_t task, size_t thread) {
+      runs[task]++;
+      if (thread >= 4)
+        bad_thread = true;
+    });
+  }
+  serial_jobs.parallelFor(num_tasks, [&](size_t task, size_t thread) {
+    runs[task]++;
+    if (thread != 0)
+      bad_thread = true;
+  });
+
+  bool all_ran = true;
+  for (auto &count : runs)
+    all_ran &= count == 4;
+  TEST_CONDITION(!all_ran, passed, "JobSystem did not run every task exactly once\n")
+  TEST_CONDITION(bad_thread, passed, "JobSystem gave a task an invalid thread index\n")
+
+  // every job queued by this thread goes on queue 0, so any other thread only
+  // got its jobs by stealing them
+  flux::job_stats_t total = jobs.getTotalStats();
+  TEST_CONDITION(total.jobs_run != 3 * num_tasks ||
+                     total.steals != total.jobs_run - jobs.getStats(0).jobs_run,
+                 passed, "JobSystem stats did not add up\n")
+  jobs.resetStats();
+  TEST_CONDITION(jobs.getTotalStats().jobs_run != 0, passed, "stats were not reset\n")
+
+  // jobs waiting on a counter should only start once all of its jobs finish
+  for (flux::JobSystem *system : {&serial_jobs, &jobs}) {
+    std::atomic<int> num_first(0);
+    std::atomic<bool> started_early(false);
+    flux::JobCounter first, second;
+    for (int i = 0; i < 100; i++)
+      system->run([&](size_t) { num_first++; }, &first);
+    for (int i = 0; i < 10; i++) {
+      system->run([&](size_t) {
+        if (num_first != 100)
+          started_early = true;
+      }, &second, &first);
+    }
+    system->wait(second);
+    TEST_CONDITION(!first.isDone() || !second.isDone() || started_early, passed,
+                   "JobSystem ran a job before its dependency\n")
+  }
+
+  // component array chunks should cover every component once, and never
+  // split a cache line
+  flux::MemoryManager memory_manager;
+  memory_manager.allocMemory(flux::ComponentArray<int>::claimSize(5000));
+  flux::ComponentArray<int> arr;
+  arr.claimMemory(&memory_manager, 5000);
+  for (int i = 0; i < 5000; i++)
+    arr.emplace(0);
+  std::atomic<bool> bad_chunk(false);
+  jobs.parallelFor(arr, 100, [&](size_t begin, size_t end, size_t) {
+    if (begin % 64 || (end % 64 && end != arr.size()) || end - begin > 128)
+      bad_chunk = true;
+    for (size_t i = begin; i < end; i++)
+      arr.modify(i)++;
+  });
+  bool all_once = true;
+  for (size_t i = 0; i < arr.size(); i++)
+    all_once &= arr.buffer_[i] == 1 && arr.isDirty(i);
+  TEST_CONDITION(bad_chunk || !all_once, passed,
+                 "JobSystem split a component array badly\n")
+
+  if (passed)
+    printf("JobSystem passed all tests!\n");
+  return passed;
+}
+
+bool testSparseSet() {
+  bool passed = true;
+  printf("Testing SparseSet ...\n");
+
+  flux::SparseSet set;
+  TEST_CONDITION(set.contains(3), passed, "empty set contained an id\n")
+  TEST_CONDITION(set.insert(10) != 0, passed, "first insert gave wrong index\n")
+  TEST_CONDITION(set.insert(3) != 1, passed, "second insert gave wrong index\n")
+  TEST_CONDITION(set.insert(7) != 2, passed, "third insert gave wrong index\n")
+  TEST_CONDITION(set.insert(3) != flux::SparseSet::INVALID_IDX, passed,
+                 "inserted the same id twice\n")
+  TEST_CONDITION(set.size() != 3, passed, "size was incorrect after inserts\n")
+  TEST_CONDITION(set.find(3) != 1 || set.ids()[1] != 3, passed,
+                 "find returned the wrong index\n")
+
+  // removing should move the last id into the hole
+  TEST_CONDITION(!set.remove(10), passed, "failed to remove an id\n")
+  TEST_CONDITION(set.remove(10), passed, "removed an id twice\n")
+  TEST_CONDITION(set.contains(10), passed, "set still contained a removed id\n")
+  TEST_CONDITION(set.find(7) != 0 || set.ids()[0] != 7, passed,
+                 "last id was not moved into the removed slot\n")
+  TEST_CONDITION(set.size() != 2, passed, "size was incorrect after remove\n")
+
+  set.clear();
+  TEST_CONDITION(set.size() != 0 || set.contains(3) || set.contains(7), passed,
+                 "clear did not empty the set\n")
+
+  if (passed)
+    printf("SparseSet passed all tests!\n");
+  return passed;
+}
+bool testAABBTree() {
+  bool passed = true;
+  printf("Testing AABBTree ...\n");
+
+  const size_t num_bounds = 200;
+  const float margin = 0.1f;
+  flux::aabb_t bounds[num_bounds];
+  int32_t proxies[num_bounds];
+  bool alive[num_bounds];
+  flux::AABBTree tree(margin);
+  srand(4321);
+  for (size_t i = 0; i < num_bounds; i++) {
+    flux::Vector2D min((rand() % 1000) / 100.0f - 5.0f, (rand() % 1000) / 100.0f - 5.0f);
+    flux::Vector2D size((rand() % 100) / 100.0f, (rand() % 100) / 100.0f);
+    bounds[i] = flux::aabb_t(min, min + size);
+    proxies[i] = tree.createProxy(bounds[i], (uint32_t)i);
+    alive[i] = true;
+  }
+  // a balanced tree of 200 leaves should be nowhere near 200 deep
+  TEST_CONDITION(tree.getHeight() > 16, passed, "tree is badly unbalanced\n")
+
+  // move everything a bit, destroy a few, and make sure queries still agree
+  // with brute force over the fat bounds
+  bool moves_valid = true, query_valid = true, ray_valid = true, nearest_valid = true;
+  for (int frame = 0; frame < 5; frame++) {
+    for (size_t i = 0; i < num_bounds; i++) {
+      if (!alive[i])
+        continue;
+      if (frame == 2 && i % 7 == 0) {
+        tree.destroyProxy(proxies[i]);
+        alive[i] = false;
+        continue;
+      }
+      flux::Vector2D delta((rand() % 21 - 10) / 100.0f, (rand() % 21 - 10) / 100.0f);
+      bounds[i] = flux::aabb_t(bounds[i].min + delta, bounds[i].max + delta);
+      tree.moveProxy(proxies[i], bounds[i]);
+      moves_valid &= flux::aabb::contains(tree.getFatBounds(proxies[i]), bounds[i]) &&
+                     tree.getUserData(proxies[i]) == i;
+    }
+
+    flux::Vector2D min((rand() % 1000) / 100.0f - 5.0f, (rand() % 1000) / 100.0f - 5.0f);
+    flux::aabb_t region(min, min + flux::Vector2D(2.0f, 1.0f));
+    std::vector<bool> found(num_bounds, false);
+    tree.query(region, [&](uint32_t idx) {
+      query_valid &= alive[idx] && !found[idx];
+      found[idx] = true;
+      return true;
+    });
+    for (size_t i = 0; i < num_bounds; i++) {
+      bool expected = alive[i] && flux::aabb::overlaps(tree.getFatBounds(proxies[i]), region);
+      query_valid &= found[i] == expected;
+    }
+
+    // with no clipping every proxy whose fat bounds the ray crosses is visited
+    flux::Vector2D origin(-6.0f, min.y), dir(1.0f, 0.1f);
+    std::fill(found.begin(), found.end(), false);
+    tree.raycast(origin, dir, 20.0f, [&](uint32_t idx, float max_t) {
+      found[idx] = true;
+      return max_t;
+    });
+    for (size_t i = 0; i < num_bounds; i++) {
+      float t;
+      bool expected = alive[i] &&
+          flux::aabb::raycast(tree.getFatBounds(proxies[i]), origin, dir, 20.0f, t);
+      ray_valid &= found[i] == expected;
+    }
+
+    // nearest has to hand proxies out closest first
+    float last_dist = -1.0f;
+    size_t num_visited = 0;
+    tree.nearest(min, [&](uint32_t idx, float dist_squared) {
+      nearest_valid &= alive[idx] && dist_squared >= last_dist &&
+          dist_squared == flux::aabb::distanceSquared(tree.getFatBounds(proxies[idx]), min);
+      last_dist = dist_squared;
+      return ++num_visited < 10;
+    });
+    nearest_valid &= num_visited == 10;
+  }
+  TEST_CONDITION(!moves_valid, passed, "moved proxies lost their bounds or data\n")
+  TEST_CONDITION(!query_valid, passed, "region query did not match brute force\n")
+  TEST_CONDITION(!ray_valid, passed, "raycast did not match brute force\n")
+  TEST_CONDITION(!nearest_valid, passed, "nearest visited proxies out of order\n")
+
+  // a proxy that barely moves should stay put in the tree
+  size_t still_alive = 1;
+  flux::aabb_t fat = tree.getFatBounds(proxies[still_alive]);
+  flux::aabb_t nudged(bounds[still_alive].min + flux::Vector2D(margin / 2, 0.0f),
+                      bounds[still_alive].max + flux::Vector2D(margin / 2, 0.0f));
+  TEST_CONDITION(flux::aabb::contains(fat, nudged) &&
+                     tree.moveProxy(proxies[still_alive], nudged),
+                 passed, "small move reinserted a proxy\n")
+
+  if (passed)
+    printf("AABBTree passed all tests!\n");
+  return passed;
+}
+
+bool testTilemapCollider() {
+  bool passed = true;
+  printf("Testing TilemapCollider ...\n");
+
+  // a walled room with some random rubble inside
+  const uint32_t width = 40, height = 30;
+  flux::TilemapCollider tilemap(width, height, 0.25f, flux::Vector2D(-5.0f, -3.0f));
+  srand(2468);
+  size_t num_solid = 0;
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      bool wall = x == 0 || y == 0 || x == width - 1 || y == height - 1;
+      bool solid = wall || rand() % 5 == 0;
+      tilemap.setSolid(x, y, solid);
+      num_solid += solid;
+    }
+  }
+  TEST_CONDITION(tilemap.isMerged(), passed, "tilemap claimed to be merged early\n")
+  tilemap.mergeSolidTiles();
+  TEST_CONDITION(!tilemap.isMerged(), passed, "tilemap was not merged\n")
+  TEST_CONDITION(tilemap.getNumBoxes() >= num_solid, passed,
+                 "merging did not reduce the number of boxes\n")
+
+  // every solid tile belongs to exactly one box that covers it, and the boxes
+  // cover nothing else
+  bool cover_valid = true;
+  float covered_area = 0.0f;
+  for (size_t i = 0; i < tilemap.getNumBoxes(); i++) {
+    const flux::aabb_t &box = tilemap.getBoxes()[i];
+    covered_area += (box.max.x - box.min.x) * (box.max.y - box.min.y);
+  }
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      uint32_t box = tilemap.getTileBox(x, y);
+      if (!tilemap.isSolid(x, y)) {
+        cover_valid &= box == flux::TilemapCollider::NO_BOX;
+        continue;
+      }
+      flux::Vector2D center = tilemap.getOrigin() +
+          flux::Vector2D((x + 0.5f) * 0.25f, (y + 0.5f) * 0.25f);
+      cover_valid &= box < tilemap.getNumBoxes() &&
+                     flux::aabb::contains(tilemap.getBoxes()[box], center);
+    }
+  }
+  cover_valid &= fabsf(covered_area - num_solid * 0.25f * 0.25f) < 1e-3f;
+  TEST_CONDITION(!cover_valid, passed, "merged boxes did not match the solid tiles\n")
+
+  // walking the tiles under some bounds finds each touching box once
+  bool find_valid = true;
+  std::vector<uint32_t> boxes;
+  for (int i = 0; i < 50; i++) {
+    flux::Vector2D min((rand() % 1200) / 100.0f - 6.0f, (rand() % 900) / 100.0f - 4.0f);
+    flux::aabb_t bounds(min, min + flux::Vector2D((rand() % 100) / 100.0f, 0.3f));
+    boxes.clear();
+    tilemap.findBoxes(bounds, boxes);
+    std::vector<bool> expected(tilemap.getNumBoxes(), false);
+    for (int32_t y = 0; y < (int32_t)height; y++) {
+      for (int32_t x = 0; x < (int32_t)width; x++) {
+        flux::Vector2D tile_min = tilemap.getOrigin() + flux::Vector2D(x * 0.25f, y * 0.25f);
+        flux::aabb_t tile(tile_min, tile_min + flux::Vector2D(0.25f, 0.25f));
+        if (tilemap.isSolid(x, y) && flux::aabb::overlaps(tile, bounds))
+          expected[tilemap.getTileBox(x, y)] = true;
+      }
+    }
+    size_t num_expected = 0;
+    for (bool e : expected)
+      num_expected += e;
+    find_valid &= boxes.size() == num_expected;
+    for (uint32_t box : boxes)
+      find_valid &= expected[box];
+  }
+  TEST_CONDITION(!find_valid, passed, "findBoxes did not match brute force\n")
+
+  // editing a tile should invalidate the merge
+  tilemap.setSolid(5, 5, !tilemap.isSolid(5, 5));
+  TEST_CONDITION(tilemap.isMerged(), passed, "editing a tile kept the old merge\n")
+
+  if (passed)
+    printf("TilemapCollider passed all tests!\n");
+  return passed;
+}
+
+bool testFrameArena() {
+  bool passed = true;
+  printf("Testing FrameArena ...\n");
+
+  flux::FrameArena arena(1024);
+  char *bytes = arena.alloc<char>(3);
+  double *doubles = arena.alloc<double>(4);
+  TEST_CONDITION(!bytes || !doubles, passed, "arena failed to give space\n")
+  TEST_CONDITION((uintptr_t)doubles % alignof(double), passed,
+                 "arena gave back a misaligned pointer\n")
+  TEST_CONDITION((char *)doubles < bytes + 3, passed, "arena allocations overlapped\n")
+  TEST_CONDITION(arena.getUsed() < 3 + sizeof(double) * 4, passed,
+                 "arena reported the wrong amount used\n")
+
+  // running out of space is an error in debug builds, and a nullptr otherwise
+  bool overflowed = false;
+  try {
+    overflowed = arena.allocBytes(2048) == nullptr;
+  } catch (std::overflow_error &) {
+    overflowed = true;
+  }
+  TEST_CONDITION(!overflowed, passed, "arena gave out more than it had\n")
+
+  // tryAlloc never throws, including when the byte count itself overflows
+  size_t used_before = arena.getUsed();
+  TEST_CONDITION(arena.fits(2048) || !arena.fits(8), passed, "arena fits was wrong\n")
+  TEST_CONDITION(arena.tryAlloc<char>(2048) || arena.tryAlloc<double>(SIZE_MAX / 4),
+                 passed, "tryAlloc gave out more than the arena had\n")
+  TEST_CONDITION(arena.getUsed() != used_before, passed,
+                 "failed tryAlloc used up arena space\n")
+
+  // reset should hand the same memory out again and remember the last frame
+  size_t used = arena.getUsed();
+  arena.reset();
+  TEST_CONDITION(arena.getUsed() != 0 || arena.getLastFrameUsed() != used ||
+                     arena.getHighWater() != used,
+                 passed, "arena stats were wrong after a reset\n")
+  TEST_CONDITION(arena.alloc<char>(3) != bytes, passed,
+                 "arena did not reuse memory after a reset\n")
+  TEST_CONDITION(!arena.alloc<char>(1000), passed, "arena failed to give space\n")
+  TEST_CONDITION(arena.getHighWater() != arena.getUsed(), passed,
+                 "arena high water mark was not updated\n")
+
+  if (passed)
+    printf("FrameArena passed all tests!\n");
+  return passed;
+}
+
+bool testHandleMap() {
+  bool passed = true;
+  printf("Testing HandleMap ...\n");
+
+  flux::MemoryManager memory_manager;
+  memory_manager.allocMemory(flux::ComponentArray<int>::claimSize(8));
+  flux::ComponentArray<int> values;
+  values.claimMemory(&memory_manager, 8);
+
+  flux::HandleMap handles;
+  flux::flux_id ids[4];
+  for (int i = 0; i < 4; i++) {
+    ids[i] = handles.create();
+    values.emplace(i);
+  }
+  TEST_CONDITION(handles.size() != 4 || handles.find(ids[2]) != 2, passed,
+                 "new handles were not packed in order\n")
+
+  // the last value should move into the hole, and its handle along with it
+  TEST_CONDITION(handles.remove(ids[1], values) != 1, passed, "failed to remove a handle\n")
+  TEST_CONDITION(handles.contains(ids[1]) || handles.remove(ids[1], values) !=
+                                                 flux::HandleMap::INVALID_IDX,
+                 passed, "removed handle was still valid\n")
+  TEST_CONDITION(values.size() != 3 || values.buffer_[handles.find(ids[3])] != 3 ||
+                     values.buffer_[handles.find(ids[0])] != 0 ||
+                     values.buffer_[handles.find(ids[2])] != 2,
+                 passed, "handles lost track of their values\n")
+  TEST_CONDITION(handles.getHandle(1) != ids[3], passed, "dense index had the wrong handle\n")
+
+  // reusing a removed handle's slot should not bring the old handle back
+  flux::flux_id reused = handles.create();
+  values.emplace(4);
+  TEST_CONDITION(reused == ids[1] || handles.contains(ids[1]) || handles.find(reused) != 3 ||
+                     reused == 0,
+                 passed, "stale handle aliased a new one\n")
+
+  if (passed)
+    printf("HandleMap passed all tests!\n");
+  return passed;
+}
+
+struct test_position_field_t { typedef flux::Vector2D type; };
+struct test_mass_field_t { typedef float type; };
+struct test_flags_field_t { typedef uint8_t type; };
+
+bool testSoAComponentArray() {
+  bool passed = true;
+  printf("Testing SoAComponentArray ...\n");
+
+  typedef flux::SoAComponentArray<test_position_field_t, test_mass_field_t, test_flags_field_t>
+      soa_array_t;
+  flux::MemoryManager memory_manager;
+  memory_manager.allocMemory(soa_array_t::claimSize(4));
+  soa_array_t arr;
+  TEST_CONDITION(!arr.claimMemory(&memory_manager, 4), passed, "claimMemory failed\n")
+
+  // every field should get its own aligned stream
+  TEST_CONDITION((uintptr_t)arr.data<test_position_field_t>() % flux::COMPONENT_ALIGNMENT ||
+                     (uintptr_t)arr.data<test_mass_field_t>() % flux::COMPONENT_ALIGNMENT ||
+                     (uintptr_t)arr.data<test_flags_field_t>() % flux::COMPONENT_ALIGNMENT,
+                 passed, "field stream was not cache line aligned\n")
+
+  for (int i = 0; i < 4; i++)
+    arr.emplace(flux::Vector2D((float)i, 0.0f), i * 2.0f, (uint8_t)i);
+  TEST_CONDITION(arr.emplace(flux::Vector2D(), 0.0f, 0), passed,
+                 "emplaced an element in a full array\n")
+  flux::component_span_t<float> masses = arr.span<test_mass_field_t>();
+  float total = 0.0f;
+  for (float mass : masses)
+    total += mass;
+  TEST_CONDITION(masses.size != 4 || total != 12.0f, passed, "field span was wrong\n")
+
+  // removing should keep every field lined up
+  TEST_CONDITION(!arr.removeSwap(0), passed, "failed to swap remove\n")
+  TEST_CONDITION(arr.size() != 3 || arr.get<test_position_field_t>(0).x != 3.0f ||
+                     arr.get<test_mass_field_t>(0) != 6.0f ||
+                     arr.get<test_flags_field_t>(0) != 3,
+                 passed, "fields were not kept in sync after a remove\n")
+
+  // dirty tracking covers the whole component, not each field
+  arr.clearDirty();
+  arr.modify<test_mass_field_t>(1) = 1.0f;
+  TEST_CONDITION(!arr.isDirty(1) || arr.isDirty(0) || arr.get<test_mass_field_t>(1) != 1.0f,
+                 passed, "modify did not mark the component dirty\n")
+  arr.removeSwap(0);
+  size_t num_dirty = 0;
+  arr.forEachDirty([&](size_t) { num_dirty++; });
+  TEST_CONDITION(num_dirty != 2 || !arr.isDirty(0), passed,
+                 "swap remove did not mark the moved component\n")
+
+  // a claim that fails partway through shouldn't leave any stream holding memory
+  flux::MemoryManager small_manager;
+  small_manager.allocMemory(flux::ComponentArray<flux::Vector2D>::claimSize(4));
+  soa_array_t unclaimed;
+  TEST_CONDITION(unclaimed.claimMemory(&small_manager, 4) ||
+                     small_manager.getAmountClaimed() != 0,
+                 passed, "failed claim left memory claimed\n")
+
+  // neither should an emplace that only some streams had room for
+  flux::MemoryManager uneven_manager;
+  uneven_manager.allocMemory(soa_array_t::claimSize(4));
+  soa_array_t uneven;
+  uneven.stream<test_position_field_t>().claimMemory(&uneven_manager, 4);
+  uneven.stream<test_mass_field_t>().claimMemory(&uneven_manager, 4);
+  uneven.stream<test_flags_field_t>().claimMemory(&uneven_manager, 2);
+  for (int i = 0; i < 3; i++)
+    uneven.emplace(flux::Vector2D(), 0.0f, 0);
+  TEST_CONDITION(uneven.size() != 2 || uneven.stream<test_position_field_t>().size() != 2 ||
+                     uneven.stream<test_mass_field_t>().size() != 2 || uneven.isDirty(2),
+                 passed, "failed emplace left the streams different sizes\n")
+
+  if (passed)
+    printf("SoAComponentArray passed all tests!\n");
+  return passed;
+}
+
+struct test_health_t {
+  int health;
+};
+struct test_name_t {
+  char letter;
+};
+
+bool testEntityRegistry() {
+  bool passed = true;
+  printf("Testing EntityRegistry ...\n");
+
+  // ids are recycled with a new generation, so old ones stop matching
+  flux::EntityRegistry registry(64);
+  flux::flux_id first = registry.create();
+  TEST_CONDITION(first == 0 || !registry.alive(first), passed, "failed to create entity\n")
+  registry.emplace(first, flux::Vector2D(1.0f, 1.0f));
+  TEST_CONDITION(!registry.destroy(first) || registry.alive(first), passed,
+                 "failed to destroy entity\n")
+  flux::flux_id reused = registry.create();
+  TEST_CONDITION(reused == first ||
+                     flux::HandleMap::getIndex(reused) != flux::HandleMap::getIndex(first),
+                 passed, "entity id was not recycled with a new generation\n")
+  TEST_CONDITION(registry.has<flux::Vector2D>(reused) || registry.get<flux::Vector2D>(first),
+                 passed, "destroyed entity's components were left behind\n")
+  TEST_CONDITION(registry.emplace(first, test_health_t{1}), passed,
+                 "added a component to a destroyed entity\n")
+  registry.destroy(reused);
+
+  // every third entity has health and every other has a position
+  std::vector<flux::flux_id> entities;
+  for (int i = 0; i < 30; i++) {
+    flux::flux_id entity = registry.create();
+    entities.push_back(entity);
+    if (i % 2 == 0)
+      registry.emplace(entity, flux::Vector2D((float)i, 0.0f));
+    if (i % 3 == 0)
+      registry.emplace(entity, test_health_t{i});
+  }
+  TEST_CONDITION(registry.get<test_health_t>(entities[9])->health != 9 ||
+                     registry.get<test_health_t>(entities[10]) ||
+                     registry.view<flux::Vector2D>().size() != 15,
+                 passed, "components were not stored per entity\n")
+
+  // a joined view should only see entities with both, with their own components
+  auto checkView = [&](size_t expected) {
+    auto view = registry.view<flux::Vector2D, test_health_t>();
+    bool valid = view.size() == expected;
+    view.each([&](flux::flux_id entity, flux::Vector2D &position, test_health_t &health) {
+      valid &= position.x == (float)health.health &&
+               registry.get<test_health_t>(entity) == &health;
+    });
+    return valid;
+  };
+  TEST_CONDITION(!checkView(5), passed, "view did not join its components\n")
+
+  // the group has to stay packed as components come and go
+  registry.emplace(entities[1], flux::Vector2D(0.0f, 0.0f));
+  registry.remove<flux::Vector2D>(entities[6]);
+  registry.destroy(entities[12]);
+  registry.remove<test_health_t>(entities[24]);
+  TEST_CONDITION(!checkView(2), passed, "view was wrong after components changed\n")
+  size_t swapped_size = registry.view<test_health_t, flux::Vector2D>().size();
+  TEST_CONDITION(swapped_size != 2, passed, "views over the same types should share a group\n")
+
+  // a pool can only be sorted for one group, so views that share a type with
+  // it fall back to lookups but still see the same entities
+  for (int i = 0; i < 30; i += 5)
+    registry.emplace(entities[i], test_name_t{(char)('a' + i)});
+  auto name_view = registry.view<test_health_t, test_name_t>();
+  auto wide_view = registry.view<test_name_t, flux::Vector2D, test_health_t>();
+  bool fallback_valid = !name_view.isGrouped() && !wide_view.isGrouped() &&
+                        name_view.size() == 2 && wide_view.size() == 1;
+  name_view.each([&](flux::flux_id entity, test_health_t &health, test_name_t &name) {
+    fallback_valid &= name.letter == 'a' + health.health &&
+                      registry.get<test_name_t>(entity) == &name;
+  });
+  wide_view.each([&](flux::flux_id entity, test_name_t &name, flux::Vector2D &position,
+                     test_health_t &health) {
+    fallback_valid &= entity == entities[0] && name.letter == 'a' && position.x == 0.0f &&
+                      health.health == 0;
+  });
+  TEST_CONDITION(!fallback_valid, passed, "views sharing a grouped pool were wrong\n")
+  TEST_CONDITION(!checkView(2), passed, "ungrouped views broke an existing group\n")
+
+  // modify should mark the component dirty for systems that only want changes
+  registry.clearDirty<flux::Vector2D>();
+  registry.modify<flux::Vector2D>(entities[4])->y = 2.0f;
+  size_t num_dirty = 0;
+  registry.pool<flux::Vector2D>().components().forEachDirty([&](size_t) { num_dirty++; });
+  TEST_CONDITION(num_dirty != 1 || registry.get<flux::Vector2D>(entities[4])->y != 2.0f, passed,
+                 "modify did not mark the component dirty\n")
+
+  // removal hooks should see the component just before it goes, whether it's
+  // removed on its own or with its entity
+  size_t num_removed = 0;
+  registry.onRemove<test_health_t>([&](flux::flux_id entity) {
+    num_removed += registry.get<test_health_t>(entity) != nullptr;
+  });
+  registry.remove<test_health_t>(entities[3]);
+  registry.destroy(entities[9]);
+  registry.destroy(entities[10]);
+  registry.onRemove<test_health_t>(nullptr);
+  registry.destroy(entities[15]);
+  TEST_CONDITION(num_removed != 2, passed, "removal hook was not called once per removal\n")
+
+  if (passed)
+    printf("EntityRegistry passed all tests!\n");
+  return passed;
+}
+
+bool testTransformManager() {
+  bool passed = true;
+  printf("Testing TransformManager ...\n");
+
+  flux::FrameArena frame_arena(1024);
+  flux::TransformManager transforms(16, &frame_arena);
+  for (int i = 0; i < 16; i++) {
+    TEST_CONDITION(!transforms.attachToEntity(i + 1, flux::Vector2D((float)i, 0.0f), i * 0.5f),
+                   passed, "failed to attach a transform\n")
+  }
+  TEST_CONDITION(transforms.attachToEntity(17, flux::Vector2D(), 0.0f), passed,
+                 "attached a transform past capacity\n")
+  TEST_CONDITION(transforms.attachToEntity(3, flux::Vector2D(), 0.0f), passed,
+                 "attached a second transform to the same entity\n")
+
+  // only the angle is stored, sin and cos are worked out in updateWorld
+  transforms.updateWorld();
+  bool rotations_valid = true;
+  for (size_t i = 0; i < transforms.size(); i++) {
+    flux::transform_t transform = transforms.getTransform(i);
+    rotations_valid &= transforms.getIdBuffer()[i] == i + 1 &&
+                       transform.trans == flux::Vector2D((float)i, 0.0f) &&
+                       fabs(transform.sin_rot - sinf(i * 0.5f)) <= 1e-6f &&
+                       fabs(transform.cos_rot - cosf(i * 0.5f)) <= 1e-6f;
+  }
+  TEST_CONDITION(!rotations_valid, passed, "transforms had the wrong sin or cos\n")
+
+  transforms.clearDirty();
+  transforms.modifyRotation(3) = 0.0f;
+  transforms.updateWorld();
+  size_t num_dirty = 0;
+  transforms.forEachDirty([&](size_t idx) { num_dirty += idx == 3 ? 1 : 2; });
+  TEST_CONDITION(num_dirty != 1 || transforms.getTransform(3).sin_rot != 0.0f ||
+                     transforms.getTransform(3).cos_rot != 1.0f,
+                 passed, "only the modified transform should have changed\n")
+
+  // a chain 1 -> 2 -> 3 plus 4 hanging off 1, attached out of order so the
+  // sort has to pull the parents forward
+  flux::TransformManager tree(8);
+  tree.attachToEntity(3, flux::Vector2D(0.0f, 1.0f), 0.0f);
+  tree.attachToEntity(1, flux::Vector2D(1.0f, 0.0f), 1.57079633f);
+  tree.attachToEntity(2, flux::Vector2D(2.0f, 0.0f), 0.0f, 1);
+  tree.attachToEntity(4, flux::Vector2D(0.0f, 3.0f), 0.0f, 1);
+  TEST_CONDITION(!tree.setParent(3, 2), passed, "failed to reparent a transform\n")
+  TEST_CONDITION(tree.setParent(1, 3), passed, "reparenting made a cycle\n")
+  TEST_CONDITION(tree.attachToEntity(5, flux::Vector2D(), 0.0f, 9), passed,
+                 "attached a transform to a missing parent\n")
+
+  auto worldOf = [&](flux::flux_id entity) {
+    return tree.getWorldBuffer()[tree.find(entity)];
+  };
+  auto near = [](flux::Vector2D v1, flux::Vector2D v2) {
+    return fabs(v1.x - v2.x) <= 1e-5f && fabs(v1.y - v2.y) <= 1e-5f;
+  };
+  auto checkTree = [&](flux::Vector2D root_trans) {
+    // 1 is turned a quarter, so its children's x axis points up
+    flux::Vector2D up(0.0f, 1.0f);
+    return near(worldOf(1).trans, root_trans) && near(worldOf(2).trans, root_trans + up * 2) &&
+           near(worldOf(3).trans, root_trans + up * 2 + flux::Vector2D(-1.0f, 0.0f)) &&
+           near(worldOf(4).trans, root_trans + flux::Vector2D(-3.0f, 0.0f)) &&
+           near(worldOf(3).x_axis, up);
+  };
+  tree.updateWorld();
+  bool sorted = true;
+  for (size_t i = 0; i < tree.size(); i++) {
+    uint32_t parent = tree.getParents()[i];
+    sorted &= parent == flux::SparseSet::INVALID_IDX || parent < i;
+  }
+  TEST_CONDITION(!sorted, passed, "transforms were not sorted by depth\n")
+  TEST_CONDITION(tree.find(1) != 0 || tree.find(3) != 3, passed,
+                 "depth sort did not give the expected order\n")
+  TEST_CONDITION(!checkTree(flux::Vector2D(1.0f, 0.0f)), passed,
+                 "world transforms were wrong after the first update\n")
+
+  // moving the root should drag its whole subtree along, and nothing else
+  tree.clearDirty();
+  tree.modifyTranslation(tree.find(1)) = flux::Vector2D(5.0f, 5.0f);
+  tree.updateWorld();
+  num_dirty = 0;
+  tree.forEachDirty([&](size_t) { num_dirty++; });
+  TEST_CONDITION(num_dirty != 4 || !checkTree(flux::Vector2D(5.0f, 5.0f)), passed,
+                 "moving the root did not update its subtree\n")
+  tree.clearDirty();
+  tree.modifyTranslation(tree.find(4)).x = 0.0f;
+  tree.updateWorld();
+  num_dirty = 0;
+  tree.forEachDirty([&](size_t idx) { num_dirty += tree.getIdBuffer()[idx] == 4 ? 1 : 2; });
+  TEST_CONDITION(num_dirty != 1, passed, "moving a leaf recomputed other transforms\n")
+
+  // detaching the middle of the chain leaves 3 as a root at its local spot
+  TEST_CONDITION(!tree.detachFromEntity(2), passed, "failed to detach a transform\n")
+  tree.updateWorld();
+  TEST_CONDITION(tree.find(2) != flux::SparseSet::INVALID_IDX ||
+                     tree.getParents()[tree.find(3)] != flux::SparseSet::INVALID_IDX ||
+                     worldOf(3).trans != flux::Vector2D(0.0f, 1.0f) ||
+                     tree.getParents()[tree.find(4)] != tree.find(1),
+                 passed, "detaching a parent left the hierarchy wrong\n")
+
+  // a full frame arena falls back to the heap instead of failing
+  frame_arena.tryAllocBytes(frame_arena.getCapacity() - frame_arena.getUsed(), 1);
+  transforms.modifyRotation(5) = 0.0f;
+  transforms.updateWorld();
+  TEST_CONDITION(transforms.getTransform(5).cos_rot != 1.0f, passed,
+                 "updateWorld failed once the frame arena was full\n")
+
+  // with a registry the world transforms end up in each entity's transform_t,
+  // and destroying an entity detaches its transform
+  flux::EntityRegistry registry(8);
+  flux::TransformManager published(8, nullptr, &registry);
+  flux::flux_id parent = registry.create();
+  flux::flux_id child = registry.create();
+  TEST_CONDITION(!published.attachToEntity(parent, flux::Vector2D(1.0f, 0.0f), 0.0f) ||
+                     !published.attachToEntity(child, flux::Vector2D(0.0f, 2.0f), 0.0f, parent),
+                 passed, "failed to attach a transform to a registry entity\n")
+  TEST_CONDITION(published.attachToEntity(parent + 1000, flux::Vector2D(), 0.0f), passed,
+                 "attached a transform to an entity that isn't alive\n")
+  published.updateWorld();
+  TEST_CONDITION(registry.get<flux::transform_t>(child)->trans != flux::Vector2D(1.0f, 2.0f),
+                 passed, "world transform was not written to the registry\n")
+  registry.destroy(parent);
+  flux::flux_id reused = registry.create();
+  TEST_CONDITION(published.find(parent) != flux::SparseSet::INVALID_IDX ||
+                     published.getParents()[published.find(child)] !=
+                         flux::SparseSet::INVALID_IDX ||
+                     !published.attachToEntity(reused, flux::Vector2D(), 0.0f),
+                 passed, "destroying an entity did not detach its transform\n")
+
+  if (passed)
+    printf("TransformManager passed all tests!\n");
+  return passed;
+}
+
+bool testCollisionManager() {
+  bool passed = true;
+  printf("Testing CollisionManager ...\n");
+
+  // the same scene in three managers, testing every pair on one thread is
+  // the reference for the other broadphases on four threads. Each manager
+  // needs its own registry, since it owns the collider_t removal hook
+  flux::EntityRegistry brute_registry(128), hash_registry(128), sweep_registry(128);
+  flux::CollisionManager brute(brute_registry, 16, flux::BROADPHASE_ALL_PAIRS, 0.5f);
+  flux::CollisionManager hash(hash_registry, 16, flux::BROADPHASE_SPATIAL_HASH, 0.5f);
+  flux::CollisionManager sweep(sweep_registry, 16, flux::BROADPHASE_SWEEP_AND_PRUNE, 0.5f);
+  hash.setNumThreads(4);
+  sweep.setNumThreads(4);
+  flux::EntityRegistry *registries[3] = {&brute_registry, &hash_registry, &sweep_registry};
+  flux::CollisionManager *managers[3] = {&brute, &hash, &sweep};
+
+  // every fifth entity gets a static rectangle, static_entities are the ones
+  // without a dynamic one as well
+  const size_t num_entities = 80;
+  std::vector<flux::flux_id> entities, static_entities;
+  srand(2468);
+  for (size_t i = 0; i < num_entities; i++) {
+    flux::transform_t trans;
+    trans.trans = flux::Vector2D((rand() % 400) / 100.0f - 2.0f, (rand() % 400) / 100.0f - 2.0f);
+    float rot = (rand() % 628) / 100.0f;
+    trans.cos_rot = cosf(rot);
+    trans.sin_rot = sinf(rot);
+    float height = (rand() % 30 + 10) / 100.0f;
+    float width = (rand() % 30 + 10) / 100.0f;
+    for (int m = 0; m < 3; m++) {
+      flux::flux_id entity = registries[m]->create();
+      registries[m]->emplace(entity, trans);
+      managers[m]->attachRectangle(entity, flux::Vector2D(), height, width, i % 5 == 0);
+      if (i % 7 == 0)
+        managers[m]->attachRectangle(entity, flux::Vector2D(0.2f, 0.0f), height, width);
+      if (m == 0)
+        entities.push_back(entity);
+      if (m == 0 && i % 5 == 0 && i % 7 != 0)
+        static_entities.push_back(entity);
+    }
+  }
+
+  bool contacts_valid = true, events_valid = true;
+  size_t total_contacts = 0;
+  for (int frame = 0; frame < 8; frame++) {
+    // drop and replace a few entities part way through, so removals shuffle
+    // the rectangles around between frames
+    if (frame == 4) {
+      for (int m = 0; m < 3; m++) {
+        managers[m]->detachRectangles(entities[3]);
+        registries[m]->destroy(entities[10]);
+        flux::flux_id entity = registries[m]->create();
+        registries[m]->emplace(entity, flux::transform_t());
+        managers[m]->attachRectangle(entity, flux::Vector2D(), 0.5f, 0.5f);
+      }
+    }
+
+    for (int m = 0; m < 3; m++) {
+      for (size_t i = frame % 3; i < entities.size(); i += 3) {
+        flux::transform_t *trans = registries[m]->modify<flux::transform_t>(entities[i]);
+        if (!trans)
+          continue;
+        trans->trans += flux::Vector2D(((int)(i * 13 + frame) % 7 - 3) / 50.0f,
+                                       ((int)(i * 5 + frame) % 7 - 3) / 50.0f);
+      }
+      managers[m]->udpateTranslations();
+      registries[m]->clearDirty<flux::transform_t>();
+      managers[m]->checkCollisions();
+    }
+
+    total_contacts += brute.getNumContacts();
+    for (int m = 1; m < 3; m++) {
+      contacts_valid &= managers[m]->getNumContacts() == brute.getNumContacts();
+      for (size_t i = 0; contacts_valid && i < brute.getNumContacts(); i++) {
+        flux::collision_contact_t &expected = brute.getContacts()[i];
+        flux::collision_contact_t &contact = managers[m]->getContacts()[i];
+        contacts_valid &= contact.entity1 == expected.entity1 &&
+                          contact.entity2 == expected.entity2 &&
+                          contact.collider1 == expected.collider1 &&
+                          contact.collider2 == expected.collider2 &&
+                          contact.axis == expected.axis && contact.depth == expected.depth;
+      }
+      events_valid &= managers[m]->getNumEvents() == brute.getNumEvents();
+      for (size_t i = 0; events_valid && i < brute.getNumEvents(); i++) {
+        flux::collision_event_t &expected = brute.getEvents()[i];
+        flux::collision_event_t &event = managers[m]->getEvents()[i];
+        events_valid &= event.type == expected.type && event.collider1 == expected.collider1 &&
+                        event.collider2 == expected.collider2;
+      }
+    }
+
+    // no static pairs, nothing on the same entity, and the contacts match up
+    // with the rectangles they name
+    for (size_t i = 0; i < brute.getNumContacts(); i++) {
+      flux::collision_contact_t &contact = brute.getContacts()[i];
+      bool static1 = false, static2 = false;
+      for (flux::flux_id entity : static_entities) {
+        static1 |= entity == contact.entity1;
+        static2 |= entity == contact.entity2;
+      }
+      contacts_valid &= contact.collider1 < contact.collider2 &&
+                        contact.entity1 != contact.entity2 && !(static1 && static2) &&
+                        brute.getColliderEntity(contact.collider1) == contact.entity1 &&
+                        brute.getColliderEntity(contact.collider2) == contact.entity2;
+    }
+  }
+  TEST_CONDITION(total_contacts == 0 || !contacts_valid, passed,
+                 "broadphases gave different contacts\n")
+  TEST_CONDITION(!events_valid, passed, "broadphases gave different events\n")
+
+  // a small hand placed scene for the events, filtering and detaching
+  flux::EntityRegistry registry(16);
+  flux::CollisionManager collisions(registry, 4);
+  flux::flux_id ids[5];
+  flux::Vector2D spots[5] = {flux::Vector2D(0.0f, 0.0f), flux::Vector2D(0.5f, 0.0f),
+                             flux::Vector2D(0.2f, 0.0f), flux::Vector2D(0.4f, 0.0f),
+                             flux::Vector2D(0.0f, 0.3f)};
+  for (int i = 0; i < 5; i++) {
+    ids[i] = registry.create();
+    flux::transform_t trans;
+    trans.trans = spots[i];
+    registry.emplace(ids[i], trans);
+  }
+  // 2 and 3 are static, and 4 is on its own layer that nothing else wants
+  TEST_CONDITION(!collisions.attachRectangle(ids[0], flux::Vector2D(), 1.0f, 1.0f) ||
+                     !collisions.attachRectangle(ids[1], flux::Vector2D(), 1.0f, 1.0f) ||
+                     !collisions.attachRectangle(ids[2], flux::Vector2D(), 1.0f, 1.0f, true) ||
+                     !collisions.attachRectangle(ids[3], flux::Vector2D(), 1.0f, 1.0f, true) ||
+                     !collisions.attachRectangle(ids[4], flux::Vector2D(), 1.0f, 1.0f, false,
+                                                 4, 4),
+                 passed, "failed to attach rectangles\n")
+  TEST_CONDITION(collisions.attachRectangle(ids[4] + 1000, flux::Vector2D(), 1.0f, 1.0f),
+                 passed, "attached a rectangle to an entity that isn't alive\n")
+
+  auto hasContact = [&](flux::flux_id entity1, flux::flux_id entity2) {
+    for (size_t i = 0; i < collisions.getNumContacts(); i++) {
+      flux::collision_contact_t &contact = collisions.getContacts()[i];
+      if ((contact.entity1 == entity1 && contact.entity2 == entity2) ||
+          (contact.entity1 == entity2 && contact.entity2 == entity1))
+        return true;
+    }
+    return false;
+  };
+  auto countEvents = [&](flux::collision_event_type_t type) {
+    size_t count = 0;
+    for (size_t i = 0; i < collisions.getNumEvents(); i++)
+      count += collisions.getEvents()[i].type == type;
+    return count;
+  };
+  auto step = [&]() {
+    collisions.udpateTranslations();
+    registry.clearDirty<flux::transform_t>();
+    collisions.checkCollisions();
+  };
+
+  step();
+  TEST_CONDITION(collisions.getNumContacts() != 5 || !hasContact(ids[0], ids[1]) ||
+                     !hasContact(ids[0], ids[2]) || !hasContact(ids[0], ids[3]) ||
+                     !hasContact(ids[1], ids[2]) || !hasContact(ids[1], ids[3]),
+                 passed, "static or masked out pairs were not skipped\n")
+  TEST_CONDITION(countEvents(flux::COLLISION_ENTER) != 5 || collisions.getNumEvents() != 5,
+                 passed, "first contacts did not all enter\n")
+
+  registry.modify<flux::transform_t>(ids[1])->trans = flux::Vector2D(5.0f, 0.0f);
+  step();
+  TEST_CONDITION(collisions.getNumContacts() != 2 || countEvents(flux::COLLISION_STAY) != 2 ||
+                     countEvents(flux::COLLISION_EXIT) != 3 || collisions.getNumEvents() != 5,
+                 passed, "moving a rectangle away gave the wrong events\n")
+
+  // detached rectangles lose their contacts without exit events
+  TEST_CONDITION(!collisions.detachRectangles(ids[0]) || collisions.detachRectangles(ids[0]),
+                 passed, "detaching rectangles did not report correctly\n")
+  step();
+  TEST_CONDITION(collisions.getNumContacts() != 0 || collisions.getNumEvents() != 0, passed,
+                 "detached rectangles still had contacts or events\n")
+
+  // destroying an entity detaches it, so its reused index can attach again.
+  // The new rectangle overlaps where 3 was, which must not show up
+  registry.destroy(ids[3]);
+  flux::flux_id reused = registry.create();
+  flux::transform_t trans;
+  trans.trans = flux::Vector2D(1.1f, 0.0f);
+  registry.emplace(reused, trans);
+  TEST_CONDITION(!collisions.attachRectangle(reused, flux::Vector2D(), 1.0f, 1.0f), passed,
+                 "failed to attach to an entity reusing a destroyed index\n")
+  step();
+  TEST_CONDITION(collisions.getNumContacts() != 1 || !hasContact(reused, ids[2]) ||
+                     countEvents(flux::COLLISION_ENTER) != 1 || collisions.getNumEvents() != 1,
+                 passed, "reused entity did not collide\n")
+
+  if (passed)
+    printf("CollisionManager passed all tests!\n");
+  return passed;
+}
@@ -2,8 +2,21 @@
 #define CORE_TESTS
 
 #include "../core/memory_manager.h"
+#include "../core/frame_arena.h"
+#include "../core/aabb_tree.h"
+#include "../core/batch_math.h"
+#include "../core/broadphase.h"
+#include "../core/narrowphase.h"
+#include "../core/tilemap_collider.h"
+#include "../core/entity_registry.h"
+#include "../core/job_system.h"
+#include "../core/transform_manager.h"
+#include "../core/collision_manager.h"
 #include "../data_structres/vectors.h"
 #include "../data_structres/component_array.h"
+#include "../data_structres/soa_component_array.h"
+#include "../data_structres/sparse_set.h"
+#include "../data_structres/handle_map.h"
 
 #define TEST_CONDITION(cond, flag, msg)                                        \
   if (cond) {                                                                  \
@@ -16,11 +29,37 @@ bool runTests();
 // ----- core -----
 #define TEST_MEMORY_MANAGER 1
 bool testMemoryManager();
+#define TEST_FRAME_ARENA 1
+bool testFrameArena();
+#define TEST_BROADPHASE 1
+bool testBroadphase();
+#define TEST_NARROWPHASE 1
+bool testNarrowphase();
+#define TEST_BATCH_MATH 1
+bool testBatchMath();
+#define TEST_JOB_SYSTEM 1
+bool testJobSystem();
+#define TEST_ENTITY_REGISTRY 1
+bool testEntityRegistry();
+#define TEST_TRANSFORM_MANAGER 1
+bool testTransformManager();
+#define TEST_AABB_TREE 1
+bool testAABBTree();
+#define TEST_TILEMAP_COLLIDER 1
+bool testTilemapCollider();
+#define TEST_COLLISION_MANAGER 1
+bool testCollisionManager();
 
 // ----- data structures
 #define TEST_VECTORS 1
 #define TEST_COMPONENT_ARRAY 1
 bool testVectors();
 bool testComponentArray();
+#define TEST_SOA_COMPONENT_ARRAY 1
+bool testSoAComponentArray();
+#define TEST_SPARSE_SET 1
+bool testSparseSet();
+#define TEST_HANDLE_MAP 1
+bool testHandleMap();
 
 #endif // CORE_TESTS